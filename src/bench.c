@@ -0,0 +1,259 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Universidade Federal de Minas Gerais
+ *   Departamento de Ciência da Computação
+ *   Programa de Pós-Graduação em Ciência da Computação
+ *   Projeto e Análise de Algoritmos
+ *
+ *   Trabalho Prático - Grafos
+ *
+ *   Autor: Leandro Augusto Lacerda Campos
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * Medição de desempenho das fases da biblioteca fleet. A entrada, no formato
+ * do programa fleet (por exemplo, gerada pelo programa gerador), é lida e
+ * convertida antes de qualquer medição; depois, cada fase é cronometrada
+ * separadamente: a montagem da frota com fleet_init() e fleet_add(), a
+ * exploração, a renumeração dos postos, a montagem do índice de ancestral
+ * comum mais baixo e o cálculo do tempo de vantagem, repetido -r vezes. Para
+ * cada fase, são impressos o tempo, a vazão em milhões de itens por segundo
+ * (teleportes na montagem e postos nas demais fases) e o pico de memória
+ * residente do processo ao fim da fase, que inclui a entrada lida. Com -j, o
+ * resultado é impresso em uma única linha no formato JSON, com os tempos em
+ * segundos, o pico de memória em kB, a contagem de naves por tipo e o tempo
+ * de vantagem.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "fleet.h"
+#include "input.h"
+
+#define USAGE   "Uso: bench [-t threads] [-r repetições] [-i sqrt|rmq] [-j] " \
+                "< entrada\n"
+
+/* fases medidas */
+#define PH_READ         0   /* leitura da entrada */
+#define PH_BUILD        1   /* fleet_init() e fleet_add() */
+#define PH_SCAN         2   /* fleet_pscan() */
+#define PH_RELABEL      3   /* fleet_relabel() */
+#define PH_INDEX        4   /* fleet_index() */
+#define PH_ADTM         5   /* fleet_padtm() */
+#define PH_COUNT        6
+
+typedef struct Phase {  /* medição de uma fase */
+    const char *name;   /* nome na tabela */
+    const char *key;    /* chave no objeto JSON */
+    double sec;         /* tempo em segundos */
+    int64_t nitem;      /* itens processados */
+    long rss;           /* pico de memória residente ao fim da fase, em kB */
+} Phase;
+
+typedef struct Pairs {  /* pares lidos de um bloco da entrada */
+    int32_t *p1;
+    int32_t *p2;
+} Pairs;
+
+bool read_pairs(Input *in, int32_t n, Pairs *pairs, int32_t nthread);
+bool set_pair(void *arg, int32_t idx, int32_t u, int32_t v);
+double now(void);
+void record(int32_t id, double sec, int64_t nitem);
+void print_table(void);
+void print_json(Fleet *fleet, int64_t adtm);
+
+static Phase phase[PH_COUNT] = {
+    {"leitura", "leitura", 0, 0, 0},
+    {"montagem", "montagem", 0, 0, 0},
+    {"exploração", "exploracao", 0, 0, 0},
+    {"renumeração", "renumeracao", 0, 0, 0},
+    {"índice", "indice", 0, 0, 0},
+    {"vantagem", "vantagem", 0, 0, 0}
+};
+
+int main(int argc, char *argv[])
+{
+    Input in;
+    Fleet fleet;
+    Pairs tp, perm;
+    int32_t nthread = 1, nrep = 3, lca = FLEET_LCA_RMQ;
+    int32_t npost, ntp;
+    int64_t ret = 0;
+    double t, best;
+    bool json = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:r:i:j")) != -1) {
+        switch (opt) {
+            case 't': nthread = atoi(optarg); break;
+            case 'r': nrep = atoi(optarg); break;
+            case 'i': lca = optarg[0] == 's' ? FLEET_LCA_SQRT : FLEET_LCA_RMQ;
+                      break;
+            case 'j': json = true; break;
+            default: fprintf(stderr, USAGE); return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc || nthread < 1 || nrep < 1) {
+        fprintf(stderr, USAGE);
+        return EXIT_FAILURE;
+    }
+
+    t = now();
+    if (input_open(&in, STDIN_FILENO) < 0 || !input_int(&in, &npost)
+        || !input_int(&in, &ntp) || npost <= 0 || ntp <= 0
+        || !read_pairs(&in, ntp, &tp, nthread)
+        || !read_pairs(&in, npost, &perm, nthread)) {
+        fprintf(stderr, "Erro ao ler a entrada\n");
+        return EXIT_FAILURE;
+    }
+    input_close(&in);
+    record(PH_READ, now() - t, npost + (int64_t)ntp);
+
+    t = now();
+    if (fleet_init(&fleet, npost, ntp) < 0) {
+        fprintf(stderr, "Erro ao inicializar a frota\n");
+        return EXIT_FAILURE;
+    }
+    for (int32_t i = 0; i < ntp; i++) {
+        if (fleet_add(&fleet, i, tp.p1[i], tp.p2[i]) < 0) {
+            fprintf(stderr, "Erro ao adicionar o teleporte %" PRId32 "\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    record(PH_BUILD, now() - t, ntp);
+
+    t = now();
+    if (fleet_pscan(&fleet, nthread) < 0) {
+        fprintf(stderr, "Erro ao explorar a frota\n");
+        return EXIT_FAILURE;
+    }
+    record(PH_SCAN, now() - t, npost);
+
+    t = now();
+    fleet_relabel(&fleet);
+    record(PH_RELABEL, now() - t, npost);
+
+    t = now();
+    fleet_index(&fleet, lca);
+    record(PH_INDEX, now() - t, npost);
+
+    best = -1;
+    for (int32_t r = 0; r < nrep; r++) {
+        t = now();
+        ret = fleet_padtm(&fleet, perm.p1, perm.p2, nthread);
+        t = now() - t;
+        if (best < 0 || t < best) best = t;
+    }
+    if (ret < 0) {
+        fprintf(stderr, "Erro ao calcular o tempo de vantagem: %" PRId64
+                "\n", ret);
+        return EXIT_FAILURE;
+    }
+    record(PH_ADTM, best, npost);
+
+    if (json) {
+        print_json(&fleet, ret);
+    } else {
+        printf("%" PRId32 " postos, %" PRId32 " teleportes, %" PRId32
+               " threads\n", npost, ntp, nthread);
+        print_table();
+        printf("tempo de vantagem: %" PRId64 "\n", ret);
+    }
+
+    fleet_free(&fleet);
+    free(tp.p1); free(perm.p1);
+    return EXIT_SUCCESS;
+}
+
+bool read_pairs(Input *in, int32_t n, Pairs *pairs, int32_t nthread)
+{   /* lê um bloco de n pares, convertidos para a base 0 */
+
+    pairs->p1 = malloc(2 * (size_t)n * sizeof(int32_t));
+    if (pairs->p1 == NULL) return false;
+    pairs->p2 = &pairs->p1[n];
+
+    if (input_pairs(in, n, set_pair, pairs, nthread) == 0) return true;
+
+    for (int32_t i = 0; i < n; i++) {
+        if (!input_int(in, &pairs->p1[i]) || !input_int(in, &pairs->p2[i])) {
+            return false;
+        }
+        pairs->p1[i]--, pairs->p2[i]--;
+    }
+    return true;
+}
+
+bool set_pair(void *arg, int32_t idx, int32_t u, int32_t v)
+{
+    Pairs *pairs = arg;
+
+    pairs->p1[idx] = u - 1;
+    pairs->p2[idx] = v - 1;
+    return true;
+}
+
+double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void record(int32_t id, double sec, int64_t nitem)
+{   /* ru_maxrss é dado em kB no Linux */
+
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    phase[id].sec = sec;
+    phase[id].nitem = nitem;
+    phase[id].rss = ru.ru_maxrss;
+}
+
+void print_table(void)
+{
+    int32_t width;
+
+    printf("fase          %10s %12s %12s\n", "tempo (s)", "Mitens/s",
+           "RSS (MB)");
+    for (int32_t i = 0; i < PH_COUNT; i++) {
+        /* o nome é alinhado pelo número de caracteres, não de bytes UTF-8 */
+        width = 0;
+        for (const char *c = phase[i].name; *c != '\0'; c++) {
+            width += (*c & 0xC0) != 0x80;
+        }
+        printf("%s%*s%10.4f %12.2f %12.1f\n", phase[i].name, 14 - width, "",
+               phase[i].sec, phase[i].sec > 0 ?
+               phase[i].nitem / phase[i].sec * 1e-6 : 0.0,
+               phase[i].rss / 1024.0);
+    }
+}
+
+void print_json(Fleet *fleet, int64_t adtm)
+{
+    int32_t stat[FLEET_NTYPE];
+
+    fleet_stat(fleet, stat);
+    printf("{\"npost\": %" PRId32 ", \"ntp\": %" PRId32 ", \"naves\": [",
+           fleet->npost, fleet->ntp);
+    for (int32_t i = 0; i < FLEET_NTYPE; i++) {
+        printf("%s%" PRId32, i > 0 ? ", " : "", stat[i]);
+    }
+    printf("], \"vantagem\": %" PRId64 ", \"rss_kb\": %ld, \"fases\": {",
+           adtm, phase[PH_COUNT - 1].rss);
+    for (int32_t i = 0; i < PH_COUNT; i++) {
+        printf("%s\"%s\": %.6f", i > 0 ? ", " : "", phase[i].key,
+               phase[i].sec);
+    }
+    printf("}}\n");
+}
@@ -0,0 +1,9 @@
+#!/bin/bash
+# mede as fases da biblioteca em frotas de 10^4 a 10^[expoente máximo] postos,
+# geradas com as opções dadas ao gerador; ex.: ./bench.sh 7 -c -p inv
+max=${1:-7}
+shift
+for e in $(seq 4 "$max"); do
+    ./gerador -n "$((10 ** e))" "$@" | ./bench -t "$(nproc)" || exit 1
+    echo
+done
@@ -1,2 +1,6 @@
 #!/bin/bash
-gcc -std=c11 -march=native -Ofast fleet.c main.c -o fleet
\ No newline at end of file
+set -e
+FLAGS="-std=c11 -march=native -Ofast -Wall -Wextra $CFLAGS"
+gcc $FLAGS -pthread fleet.c input.c main.c -o fleet -lm
+gcc $FLAGS gerador.c -o gerador -lm
+gcc $FLAGS -pthread fleet.c input.c bench.c -o bench -lm
@@ -11,22 +11,281 @@
  * 
  * ----------------------------------------------------------------------- */
 
+#define _DEFAULT_SOURCE
+
 #include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include "fleet.h"
 
 /* para os algoritmos de exploração de frota e cálculo de tempo de vantagem */
 #define NIL     (-1)  /* ausência de antecessor na árvore de BP de uma nave */
 #define ND      (-2)  /* atributo jump não calculado */
 
+/* grupo do posto p no bitset de grupos g */
+#define GROUP_OF(g, p)  ((int32_t)(((g)[(p) >> 6] >> ((p) & 63)) & 1))
+
+/* número de palavras do bitset de grupos de n postos */
+#define GROUP_NWORD(n)  (((size_t)(n) + 63) / 64)
+
+/* número mínimo de postos por thread em fleet_pscan() e fleet_padtm() */
+#define PAR_MINPOST 8192
+
+/* número máximo de pares por tarefa em fleet_padtm() */
+#define PAR_BLOCK   1024
+
+/* consultas por bloco de fleet_dist_batch(); os dados de um bloco devem
+   caber na cache */
+#define DIST_BLOCK  256
+
+/* grupos de consultas de fleet_dist_batch(), além dos tipos de nave */
+#define QRY_OTHER   FLEET_NTYPE         /* respondidas por get_dist() */
+#define QRY_DONE    (FLEET_NTYPE + 1)   /* respondidas na classificação */
+#define QRY_NKEY    (FLEET_NTYPE + 2)   /* quantidade de grupos */
+
+/* número de teleportes lidos ou copiados de uma vez por fleet_xscan() e
+   fleet_count() */
+#define XS_CHUNK    65536
+
+/* limites, em teleportes, do buffer de gravação de cada grupo de naves de
+   fleet_xscan() */
+#define XS_MINBUF   256
+#define XS_MAXBUF   4096
+
+/* instrumentação: com FLEET_METRICS definido, cada thread acumula os seus
+   contadores em metric_local, somados a Fleet::metrics por METRIC_FLUSH() ao
+   fim de cada tarefa e de cada função pública instrumentada, e os tempos
+   medidos entre METRIC_START() e METRIC_STOP() são somados diretamente; sem
+   FLEET_METRICS, as macros não geram código */
+#ifdef FLEET_METRICS
+#define METRIC_ON                   true
+#define METRIC_ADD(field, n)        (metric_local.field += (n))
+#define METRIC_START(t)             double t = metric_now()
+#define METRIC_STOP(fleet, t, field) \
+        ((fleet)->metrics.field += metric_now() - (t))
+#define METRIC_FLUSH(fleet)         metric_flush(fleet)
+#else
+#define METRIC_ON                   false
+#define METRIC_ADD(field, n)        ((void)0)
+#define METRIC_START(t)             ((void)0)
+#define METRIC_STOP(fleet, t, field) ((void)0)
+#define METRIC_FLUSH(fleet)         ((void)0)
+#endif
+
+/* para a imagem binária gravada por fleet_save() */
+#define IMG_MAGIC   "FLEETIMG"  /* identificação do arquivo */
+#define IMG_BOM     0x01020304  /* marca da ordem de bytes da máquina */
+
+/* seções da imagem binária, na ordem em que são gravadas */
+enum {
+    IMG_SHIP,       /* nship registros {type, npost, root, height} */
+    IMG_POSTSHIP,   /* id da nave de cada posto */
+    IMG_PI,         /* pai de cada posto */
+    IMG_DEPTH,      /* profundidade de cada posto */
+    IMG_JUMP,       /* atributo jump de cada posto */
+    IMG_POS,        /* posição de cada posto no caminho ou ciclo da nave */
+    IMG_GROUP,      /* bitset de grupos dos postos, em palavras de 64 bits */
+    IMG_TP,         /* ntp registros {p1, p2} */
+    IMG_ADJIDX,     /* npost + 1 deslocamentos */
+    IMG_ADJ,        /* 2 * ntp destinos */
+    IMG_LABEL,      /* Fleet::label, se a frota foi renumerada, ou vazia */
+    IMG_NSEC        /* quantidade de seções */
+};
+
+typedef struct ImgHeader {  /* cabeçalho da imagem binária */
+    char magic[8];          /* IMG_MAGIC, sem o terminador */
+    uint32_t version;       /* FLEET_IMGVER */
+    uint32_t bom;           /* IMG_BOM */
+    int32_t nship;
+    int32_t npost;
+    int32_t ntp;
+    int32_t label;          /* 1 se a frota foi renumerada, 0 caso contrário */
+} ImgHeader;
+
+/* os registros de nave da imagem são gravados diretamente do vetor de naves */
+_Static_assert(sizeof(Ship) == 4 * sizeof(int32_t), "Ship com preenchimento");
+
+typedef struct Scan {       /* estado compartilhado por fleet_pscan() */
+    Fleet *fleet;
+    int32_t nthread;
+    atomic_int *parent;     /* floresta da união-busca dos postos */
+    int32_t mpost;          /* maior número de postos em uma nave */
+    atomic_int next;        /* id da próxima nave a ser explorada */
+    atomic_bool nomem;      /* alguma thread não conseguiu alocar memória */
+} Scan;
+
+typedef struct ScanTask {   /* parte de fleet_pscan() a cargo de uma thread */
+    Scan *scan;
+    int32_t id;             /* de 0 a nthread - 1 */
+} ScanTask;
+
+typedef struct Adtm {       /* estado compartilhado por fleet_padtm() */
+    Fleet *fleet;
+    int32_t *p1;
+    int32_t *p2;
+    int32_t *qoff;          /* pares da nave k: qidx[qoff[k]..qoff[k+1]-1] */
+    int32_t *qidx;          /* índices dos pares, agrupados por nave */
+    int32_t nblock;         /* número de blocos de pares */
+    int32_t *blk;           /* início do bloco b em qidx */
+    int32_t *blk_ship;      /* nave do bloco b */
+    atomic_int next;        /* próxima nave ou próximo bloco a processar */
+    _Atomic int64_t *s;     /* soma das distâncias por nave */
+    atomic_int *r;          /* n. de blocos ainda a processar por nave */
+    _Atomic int64_t m;      /* menor soma encontrada */
+    atomic_bool error;      /* algum par não está em uma nave conhecida */
+    atomic_bool nomem;      /* alguma thread não conseguiu alocar memória */
+} Adtm;
+
+typedef struct AdtmTask {   /* parte de fleet_padtm() a cargo de uma thread */
+    Adtm *adtm;
+    int32_t id;             /* de 0 a nthread - 1 */
+} AdtmTask;
+
+typedef struct TaskThread { /* thread de uma tarefa de run_tasks() */
+    pthread_t id;
+    bool created;           /* a thread foi criada */
+} TaskThread;
+
+#ifdef FLEET_METRICS
+static _Thread_local FleetMetrics metric_local;
+static pthread_mutex_t metric_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+typedef struct XScan {      /* estado de fleet_xscan() */
+    Fleet *fleet;
+    FleetReadFn read;
+    void *arg;
+    int64_t cap;            /* teleportes por grupo de naves */
+    int32_t *sid;           /* nave de cada posto, pela união-busca */
+    int32_t *deg;           /* grau de cada posto */
+    int32_t nbucket;        /* número de grupos de naves */
+    int32_t *bucket;        /* grupo de cada nave */
+    int64_t *boff;          /* teleportes do grupo b: boff[b]..boff[b+1]-1 */
+    FILE *raw;              /* teleportes na ordem da entrada */
+    FILE *part;             /* teleportes agrupados por grupo de naves */
+} XScan;
+
+typedef struct ShipBound {  /* cota inferior da soma das distâncias na nave */
+    int64_t bound;
+    int32_t id;
+} ShipBound;
+
+struct FleetWork {          /* área de trabalho de fleet_work_adtm(), alocada
+                               uma vez para uma frota e um número de threads */
+    Fleet *fleet;           /* frota consultada, que não deve ser alterada */
+    int32_t nship;          /* número de naves da frota na criação */
+    int32_t nthread;        /* threads, limitadas pelo tamanho da frota */
+    int32_t *map;           /* pares traduzidos para a numeração interna */
+    int32_t *qoff;          /* pares agrupados por nave */
+    int32_t *qidx;
+    int64_t *bound;         /* cota inferior da soma das distâncias por nave */
+    int64_t *dist;          /* distância, ou cota, de cada par */
+    ShipBound *cand;        /* fragatas que ainda podem reduzir a soma */
+
+    /* vetores alocados apenas com nthread > 1 */
+    int32_t *blk;           /* início de cada bloco de pares em qidx */
+    int32_t *blk_ship;      /* nave de cada bloco */
+    int32_t *order;         /* naves por número decrescente de pares */
+    int32_t *cnt;           /* contagem da ordenação das naves */
+    _Atomic int64_t *s;     /* soma das distâncias por nave */
+    _Atomic int *r;         /* número de blocos ainda a processar por nave */
+    AdtmTask *task;         /* tarefas das threads */
+    TaskThread *thread;     /* threads das tarefas */
+};
+
 /* Declaração de funções internas */
-static inline Ship *add_ship(Fleet *fleet, int32_t id, int32_t root);
-static void ship_visit(Fleet *fleet, Ship *ship);
-static inline void add_post(Fleet *fleet, Ship *ship, Post *post, int32_t pi);
+static int64_t adtm_run(Fleet *fleet, int32_t *p1, int32_t *p2,
+                        FleetWork *work);
+static int32_t batch_run(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                         int32_t n, int64_t *out, bool exact);
+static int64_t ship_sum(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                        const int32_t *qidx, int32_t n, int64_t m);
+static int bound_cmp(const void *a, const void *b);
+static int64_t padtm_run(Fleet *fleet, int32_t *p1, int32_t *p2,
+                         FleetWork *work);
+static void map_pairs(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                      int32_t n, int32_t *q);
+static inline int32_t map_post(Fleet *fleet, int32_t p);
+static void relabel_array(int32_t *a, const int32_t *label, int32_t *tmp,
+                          int32_t n, bool ids);
+static void pack_adj(Fleet *fleet);
+static int32_t bucket_pairs(Fleet *fleet, int32_t *p1, int32_t *p2,
+                            int32_t *qoff, int32_t *qidx);
+static void *adtm_jump(void *arg);
+static void *adtm_sum(void *arg);
+static inline void atomic_min(_Atomic int64_t *x, int64_t y);
+static void run_tasks(void *task, size_t size, int32_t ntask,
+                      void *(*fn)(void *), TaskThread *thread);
+static void *scan_union(void *arg);
+static void *scan_find(void *arg);
+static void *scan_visit(void *arg);
+static void *scan_group(void *arg);
+static void set_group(Fleet *fleet, size_t first, size_t last);
+static inline int32_t uf_find(atomic_int *parent, int32_t u);
+static int32_t xs_union(XScan *xs);
+static int32_t xs_split(XScan *xs);
+static bool xs_flush(FILE *part, const int32_t *w, int32_t *n, int64_t *pos);
+static int32_t xs_visit(XScan *xs);
+static void xs_free(XScan *xs);
+static size_t img_layout(int32_t nship, int32_t npost, int32_t ntp,
+                         bool label, size_t *off);
+static bool img_write(FILE *file, const void *data, size_t len);
+static bool img_adj(FILE *file, const Fleet *fleet);
+static int32_t img_load(Fleet *fleet, char *img, size_t size,
+                        const size_t *off);
+static int32_t img_check(Fleet *fleet);
+static inline bool img_owns(const Fleet *fleet, const void *ptr);
+static void img_free(Fleet *fleet, void *ptr);
+static void *img_realloc(Fleet *fleet, void *ptr, size_t len, size_t size);
+static void img_unmap(Fleet *fleet);
+static bool ship_alloc(Fleet *fleet, int32_t mship);
+static inline int32_t add_ship(Fleet *fleet, int32_t root);
+static void ship_visit(Fleet *fleet, int32_t id, int32_t *stack);
+static inline void add_post(Fleet *fleet, int32_t id, int32_t p, int32_t pi);
+static void post_free(Posts *post);
+static bool post_alloc(Posts *post, int32_t npost);
+static void scan_free(Fleet *fleet);
+static bool adj_reserve(Fleet *fleet, int32_t u, int32_t n);
+static bool tp_grow(Fleet *fleet, int32_t idx);
+static void adj_insert(Fleet *fleet, int32_t u, int32_t v);
+static void adj_remove(Fleet *fleet, int32_t u, int32_t v);
+static int32_t ship_clear(Fleet *fleet, int32_t p, int32_t a, int32_t b,
+                          int32_t *list, int32_t *stack);
+static void ship_redo(Fleet *fleet, int32_t id, int32_t root,
+                      const int32_t *list, int32_t n, int32_t *stack);
+static void ship_drop(Fleet *fleet, int32_t id, int32_t *stack);
 static inline void ship_class(Ship *ship, int32_t mdeg, int32_t nback);
+static void set_pos(Fleet *fleet, Ship *ship);
+static inline int32_t path_child(Fleet *fleet, int32_t u);
+static void dist_bucket(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                        const int32_t *idx, int32_t n, int32_t type,
+                        int64_t *out);
+static void dist_cycle(const int32_t *idx, int32_t *a, const int32_t *b,
+                       const int32_t *len, int32_t n, int64_t *out);
 static int64_t get_dist(Fleet *fleet, int32_t p1, int32_t p2);
-static void set_jump(Fleet *fleet, int32_t p, int32_t block_sz);
+static int32_t set_jump(Fleet *fleet, Ship *ship);
 static int32_t get_lca(Fleet *fleet, int32_t p1, int32_t p2);
+static int32_t rmq_build(Fleet *fleet);
+static void heap_fix(FleetQuery *query, int32_t i);
+static void heap_down(FleetQuery *query, int32_t i);
+static int32_t batch_tree(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                          int32_t n, int64_t *out);
+static inline int32_t uf_root(int32_t *uf, int32_t u);
+static inline int32_t rmq_child(Fleet *fleet, int32_t p1, int32_t p2);
+#ifdef FLEET_METRICS
+static double metric_now(void);
+static void metric_flush(Fleet *fleet);
+#endif
 
 /* ------------------------------------------------------------------------- *
  *
@@ -63,8 +322,9 @@ static int32_t get_lca(Fleet *fleet, int32_t p1, int32_t p2);
 
 int32_t fleet_init(Fleet *fleet, int32_t npost, int32_t ntp)
 {
-    Post *post;
+    Posts post;
     Teleport *tp;
+    int32_t *adj_idx, *adj_end, *adj;
 
     if (fleet == NULL) return -1;
 
@@ -72,34 +332,92 @@ int32_t fleet_init(Fleet *fleet, int32_t npost, int32_t ntp)
 
     if (ntp < FLEET_MINTP || ntp > FLEET_MAXTP) return -3;
     
-    post = malloc(npost * sizeof(Post));
-    if (post == NULL) return -4;
-
-    /* 2 * ntp pois (u, v) implica v em Adj[u] e u em Adj[v] no grafo da frota */
-    tp = malloc(2 * ntp * sizeof(Teleport));
-    if (tp == NULL) { free(post); return -5; }
+    if (!post_alloc(&post, npost)) return -4;
+
+    tp = malloc(ntp * sizeof(Teleport));
+    if (tp == NULL) { post_free(&post); return -5; }
+
+    /* 2 * ntp pois (u, v) implica v em Adj[u] e u em Adj[v] no grafo da
+       frota */
+    adj_idx = malloc((npost + 1) * sizeof(int32_t));
+    adj_end = malloc(npost * sizeof(int32_t));
+    adj = malloc(2 * ntp * sizeof(int32_t));
+    if (adj_idx == NULL || adj_end == NULL || adj == NULL) {
+        free(adj_idx); free(adj_end); free(adj); free(tp); post_free(&post);
+        return -5;
+    }
     
-    for (int32_t i = 0; i < npost; i++) {
-        post[i].tp = NULL;  /* necessário para criação de lista encadeada */
+    for (int32_t i = 0; i < ntp; i++) {
+        tp[i].p1 = NIL;     /* teleporte ainda não adicionado */
     }
     fleet->nship = 0;
+    fleet->mship = 0;
     fleet->ship = NULL;
     fleet->npost = npost;
+    fleet->mpost = npost;
     fleet->post = post;
     fleet->ntp = ntp;
+    fleet->mtp = ntp;
     fleet->tp = tp;
+    fleet->madj = 2 * ntp;
+    fleet->adj_idx = adj_idx;
+    fleet->adj_end = adj_end;
+    fleet->adj_lim = NULL;
+    fleet->adj = adj;
+    fleet->lca = FLEET_LCA_SQRT;
+    fleet->lca_n = 0;
+    fleet->lca_nlev = 0;
+    fleet->lca_pre = NULL;
+    fleet->lca_tbl = NULL;
+    fleet->label = NULL;
+    fleet->origin = NULL;
+    fleet->img = NULL;
+    fleet->img_size = 0;
+    memset(&fleet->metrics, 0, sizeof(FleetMetrics));
+
+    return 0;
+}
+
+int32_t fleet_reset(Fleet *fleet, int32_t npost, int32_t ntp)
+{
+    int32_t mpost, mtp, ret;
+
+    if (fleet == NULL) return -1;
+
+    if (npost < FLEET_MINPOST || npost > FLEET_MAXPOST) return -2;
+
+    if (ntp < FLEET_MINTP || ntp > FLEET_MAXTP) return -3;
+
+    if (fleet->post.ship == NULL) return fleet_init(fleet, npost, ntp);
+
+    if (npost > fleet->mpost || ntp > fleet->mtp || 2 * ntp > fleet->madj) {
+        mpost = max(npost, fleet->mpost);
+        mtp = max(ntp, fleet->mtp);
+        fleet_free(fleet);
+        if ((ret = fleet_init(fleet, mpost, mtp)) < 0) return ret;
+    } else {
+        scan_free(fleet);
+    }
+    for (int32_t i = 0; i < ntp; i++) {
+        fleet->tp[i].p1 = NIL;     /* teleporte ainda não adicionado */
+    }
+    fleet->npost = npost;
+    fleet->ntp = ntp;
+    memset(&fleet->metrics, 0, sizeof(FleetMetrics));
 
     return 0;
 }
 
 int32_t fleet_add(Fleet *fleet, int32_t idx, int32_t p1, int32_t p2)
 {
-    int32_t npost = fleet->npost;
-    int32_t ntp = fleet->ntp;
+    int32_t npost, ntp;
     Teleport *tp;
-    Post *post;
 
-    if (fleet == NULL || fleet->post == NULL || fleet->tp == NULL) return -1;
+    if (fleet == NULL || fleet->post.ship == NULL
+        || fleet->tp == NULL) return -1;
+
+    npost = fleet->npost;
+    ntp = fleet->ntp;
 
     if (idx < 0 || idx >= ntp) return -2;
 
@@ -107,19 +425,10 @@ int32_t fleet_add(Fleet *fleet, int32_t idx, int32_t p1, int32_t p2)
 
     if (fleet->ship != NULL) return -4;
 
-    /* adiciona teleporte de p1 para p2 */
+    /* as listas de adjacências só são montadas em fleet_scan() */
     tp = &fleet->tp[idx];
-    post = &fleet->post[p1];
-    tp->to = p2;
-    tp->next = post->tp;
-    post->tp = tp;
-
-    /* adiciona teleporte de p2 para p1 */
-    tp = &fleet->tp[ntp + idx];
-    post = &fleet->post[p2];
-    tp->to = p1;
-    tp->next = post->tp;
-    post->tp = tp;
+    tp->p1 = p1;
+    tp->p2 = p2;
 
     return idx + 1;
 }
@@ -127,294 +436,2832 @@ int32_t fleet_add(Fleet *fleet, int32_t idx, int32_t p1, int32_t p2)
 int32_t fleet_scan(Fleet *fleet)
 {   /* baseado no algoritmo de busca em profundidade */
 
-    Ship *ship;
-    Post *post;
-    int32_t counter = 0;    /* contagem de naves na frota */
+    int32_t *stack;         /* pilha da busca em profundidade */
+    int32_t id;
 
-    if (fleet == NULL || fleet->post == NULL || fleet->tp == NULL) return -1;
+    if (fleet == NULL || fleet->post.ship == NULL || fleet->tp == NULL)
+        return -1;
 
     if (fleet->ship != NULL) return -2;
 
+    stack = malloc(fleet->npost * sizeof(int32_t));
+    if (stack == NULL) return -3;
+
+    METRIC_START(t0);
+    pack_adj(fleet);
+
     for (int32_t i = 0; i < fleet->npost; i++) {
-        post = &fleet->post[i];
-        post->ship = NULL;
-        post->pi = NIL;
+        fleet->post.ship[i] = NIL;
+        fleet->post.pi[i] = NIL;
     }
     for (int32_t i = 0; i < fleet->npost; i++) {
-        post = &fleet->post[i];
-        if (post->ship == NULL) {
+        if (fleet->post.ship[i] == NIL) {
             /* uma nova nave encontrada */
-            ship = add_ship(fleet, counter++, i);
-            if (ship == NULL) return -3;
+            id = add_ship(fleet, i);
+            if (id == NIL) { free(stack); scan_free(fleet); return -3; }
             /* explora a nave encontrada */
-            ship_visit(fleet, ship);
+            ship_visit(fleet, id, stack);
         }
     }
-    return counter;
+    free(stack);
+    set_group(fleet, 0, GROUP_NWORD(fleet->npost));
+    METRIC_STOP(fleet, t0, t_scan);
+    METRIC_FLUSH(fleet);
+
+    return fleet->nship;
 }
 
-int32_t fleet_stat(Fleet *fleet, int32_t *stat)
-{
-    if (fleet == NULL || fleet->ship == NULL) return -1;
+int32_t fleet_pscan(Fleet *fleet, int32_t nthread)
+{   /* baseado em união-busca concorrente seguida de buscas em profundidade
+       independentes, uma por nave */
 
-    if (stat == NULL) return -2;
+    Scan scan;
+    ScanTask *task;
+    int32_t npost, nship = 0;
+    int32_t *size;
 
-    for (int32_t i = 0; i < FLEET_NTYPE; i++) stat[i] = 0;
+    if (fleet == NULL || fleet->post.ship == NULL
+        || fleet->tp == NULL) return -1;
+
+    if (fleet->ship != NULL) return -2;
+
+    npost = fleet->npost;
+    if (nthread > npost / PAR_MINPOST) nthread = npost / PAR_MINPOST;
+    if (nthread <= 1) return fleet_scan(fleet);
+
+    /* sem memória para a versão paralela */
+    if ((task = malloc(nthread * sizeof(ScanTask))) == NULL)
+        return fleet_scan(fleet);
+
+    METRIC_START(t0);
+    scan.fleet = fleet;
+    scan.nthread = nthread;
+    scan.parent = malloc(npost * sizeof(atomic_int));
+    size = calloc(npost, sizeof(int32_t));
+    if (scan.parent == NULL || size == NULL) {
+        free(scan.parent); free(size); free(task);
+        return -3;
+    }
+    atomic_init(&scan.next, 0);
+    atomic_init(&scan.nomem, false);
+    for (int32_t i = 0; i < nthread; i++) {
+        task[i].scan = &scan;
+        task[i].id = i;
+    }
+    for (int32_t i = 0; i < npost; i++) atomic_init(&scan.parent[i], i);
 
-    for (Ship *ship = fleet->ship; ship != NULL; ship = ship->next) {
-        stat[ship->type]++;
+    pack_adj(fleet);
+    run_tasks(task, sizeof(ScanTask), nthread, scan_union, NULL);
+    run_tasks(task, sizeof(ScanTask), nthread, scan_find, NULL);
+
+    /* cada raiz é o posto de menor índice da sua nave; logo, as naves
+       recebem os mesmos ids que em fleet_scan() */
+    scan.mpost = 0;
+    for (int32_t i = 0; i < npost; i++) {
+        int32_t r = atomic_load_explicit(&scan.parent[i], memory_order_relaxed);
+        if (r == i) nship++;
+        if (++size[r] > scan.mpost) scan.mpost = size[r];
     }
+    free(size);
+    if (!ship_alloc(fleet, nship)) { free(scan.parent); free(task); return -3; }
+    for (int32_t i = 0; i < npost; i++) {
+        if (atomic_load_explicit(&scan.parent[i], memory_order_relaxed) == i)
+            add_ship(fleet, i);
+    }
+    free(scan.parent);
+
+    run_tasks(task, sizeof(ScanTask), nthread, scan_visit, NULL);
+    run_tasks(task, sizeof(ScanTask), nthread, scan_group, NULL);
+    free(task);
+    METRIC_STOP(fleet, t0, t_scan);
+
+    /* as naves ficaram exploradas em parte: a frota volta ao estado anterior
+       à exploração, de modo que ela possa ser explorada de novo */
+    if (atomic_load(&scan.nomem)) { scan_free(fleet); return -3; }
+
+    return nship;
+}
+
+int32_t fleet_xscan(Fleet *fleet, int32_t npost, int32_t ntp,
+                    FleetReadFn read, void *arg, size_t mem)
+{   /* exploração semi-externa: só os vetores indexados por posto ficam
+       inteiros em memória, e os teleportes passam por dois arquivos
+       temporários, o segundo ordenado por grupo de naves */
+
+    XScan xs = {0};
+    int32_t ret;
+
+    if (fleet == NULL || read == NULL) return -1;
+
+    if (npost < FLEET_MINPOST || npost > FLEET_MAXPOST
+        || ntp < FLEET_MINTP || ntp > FLEET_MAXTP) return -2;
+
+    if (!post_alloc(&fleet->post, npost)) return -3;
+
+    fleet->nship = 0;
+    fleet->mship = 0;
+    fleet->ship = NULL;
+    fleet->npost = npost;
+    fleet->mpost = npost;
+    fleet->ntp = ntp;
+    fleet->mtp = 0;
+    fleet->tp = NULL;
+    fleet->madj = 0;
+    fleet->adj_idx = NULL;
+    fleet->adj_end = NULL;
+    fleet->adj_lim = NULL;
+    fleet->adj = NULL;
+    fleet->lca = FLEET_LCA_SQRT;
+    fleet->lca_n = 0;
+    fleet->lca_nlev = 0;
+    fleet->lca_pre = NULL;
+    fleet->lca_tbl = NULL;
+    fleet->label = NULL;
+    fleet->origin = NULL;
+    fleet->img = NULL;
+    fleet->img_size = 0;
+    memset(&fleet->metrics, 0, sizeof(FleetMetrics));
+
+    METRIC_START(t0);
+    xs.fleet = fleet;
+    xs.read = read;
+    xs.arg = arg;
+    /* cada teleporte do grupo ocupa 2 inteiros lidos e 2 nas listas */
+    xs.cap = max((int64_t)(mem / (4 * sizeof(int32_t))), (int64_t)1);
+    ret = xs_union(&xs);
+    if (ret == 0) ret = xs_split(&xs);
+    if (ret == 0) ret = xs_visit(&xs);
+    xs_free(&xs);
+    if (ret < 0) { fleet_free(fleet); return ret; }
+
+    set_group(fleet, 0, GROUP_NWORD(npost));
+    METRIC_STOP(fleet, t0, t_scan);
+    METRIC_FLUSH(fleet);
+
     return fleet->nship;
 }
 
-int64_t fleet_adtm(Fleet *fleet, int32_t *p1, int32_t *p2)
-{    
-    int32_t r[fleet->nship];    /* n. de cálculos ainda a executar por nave */
-    int64_t s[fleet->nship];    /* soma das distâncias por nave */
-    int64_t m = FLEET_INF;      /* menor soma encontrada: dada a nave i, 
-                                   se r[i] = 0 então m <= s[i] */
-    int64_t d;                  /* distância entre dois postos */
-    int32_t u, v;
-    Ship *ship;
+int32_t fleet_count(int32_t npost, int32_t ntp, FleetReadFn read, void *arg,
+                    int32_t *stat)
+{   /* em cada nave, o número de arestas fora da árvore de busca é o de
+       teleportes menos o de postos mais 1, e a classificação não depende da
+       ordem em que as arestas são percorridas */
 
-    if (fleet == NULL || fleet->post == NULL 
-        || fleet->tp == NULL || fleet->ship == NULL) return -1;
+    int32_t *buf, *parent, *deg, *size, *mdeg;
+    int64_t *nedge;             /* soma dos graus dos postos de cada nave */
+    int32_t n, u, v, r, nship = 0;
+    Ship ship;
+
+    if (read == NULL || stat == NULL) return -1;
 
-    for (ship = fleet->ship; ship != NULL; ship = ship->next) {
-        s[ship->id] = 0; r[ship->id] = ship->npost; 
+    if (npost < FLEET_MINPOST || npost > FLEET_MAXPOST
+        || ntp < FLEET_MINTP || ntp > FLEET_MAXTP) return -2;
+
+    parent = malloc(npost * sizeof(int32_t));
+    deg = calloc(npost, sizeof(int32_t));
+    buf = malloc(2 * XS_CHUNK * sizeof(int32_t));
+    if (parent == NULL || deg == NULL || buf == NULL) {
+        free(parent); free(deg); free(buf);
+        return -3;
     }
-    for (int32_t i = 0; i < fleet->npost; i++) {
-        u = p1[i]; v = p2[i];
-        if (u < 0 || u >= fleet->npost || v < 0 || v >= fleet->npost) 
-            return -2;
 
-        ship = fleet->post[u].ship;
-        if (s[ship->id] < m) {
-            /* s[ship->id] >= m implica que s[ship->id] não poderá ser um 
-               novo limitante inferior */
-            if (u != v) {
-                /* u = v implica d(u, v) = 0 */
-                d = get_dist(fleet, u, v);
-                if (d == -1 || d == FLEET_INF) {
-                    /* u e v não estão na mesma nave ou a nave é de 
-                       tipo desconhecido */
-                    return -3;
-                }
-                s[ship->id] += d;
-            }
-            r[ship->id]--;
-            if (r[ship->id] == 0 && s[ship->id] < m) m = s[ship->id];
-            
-            if (m <= 1) {
-                /* m <= 1 é a menor cota inferior possível */
-                return 0;
+    for (int32_t i = 0; i < npost; i++) parent[i] = i;
+    for (int32_t done = 0; done < ntp; done += n) {
+        n = min(ntp - done, XS_CHUNK);
+        if (read(arg, buf, buf + XS_CHUNK, n) != n) {
+            free(parent); free(deg); free(buf);
+            return -4;
+        }
+        for (int32_t k = 0; k < n; k++) {
+            u = buf[k]; v = buf[XS_CHUNK + k];
+            if (u < 0 || u >= npost || v < 0 || v >= npost) {
+                free(parent); free(deg); free(buf);
+                return -4;
             }
+            deg[u]++; deg[v]++;
+            u = uf_root(parent, u);
+            v = uf_root(parent, v);
+            if (u < v) parent[v] = u;
+            else parent[u] = v;
         }
     }
-    return m / 2;
+    free(buf);
+
+    size = calloc(npost, sizeof(int32_t));
+    mdeg = calloc(npost, sizeof(int32_t));
+    nedge = calloc(npost, sizeof(int64_t));
+    if (size == NULL || mdeg == NULL || nedge == NULL) {
+        free(parent); free(deg); free(size); free(mdeg); free(nedge);
+        return -3;
+    }
+    for (int32_t i = 0; i < npost; i++) {
+        r = uf_root(parent, i);
+        size[r]++;
+        nedge[r] += deg[i];
+        if (deg[i] > mdeg[r]) mdeg[r] = deg[i];
+    }
+    free(parent); free(deg);
+
+    for (int32_t i = 0; i < FLEET_NTYPE; i++) stat[i] = 0;
+    for (int32_t i = 0; i < npost; i++) {
+        if (size[i] == 0) continue;
+        ship_class(&ship, mdeg[i], (int32_t)(nedge[i] / 2 - (size[i] - 1)));
+        stat[ship.type]++;
+        nship++;
+    }
+    free(size); free(mdeg); free(nedge);
+
+    return nship;
 }
 
-void fleet_free(Fleet *fleet)
-{
-    Ship *next;
+int32_t fleet_link(Fleet *fleet, int32_t idx, int32_t p1, int32_t p2)
+{   /* as naves de p1 e p2 são exploradas novamente como uma só, que fica com
+       o menor dos dois ids */
 
-    if (fleet == NULL) return;
+    int32_t a, b, n;
+    int32_t *list, *stack;
+    size_t len, mlen;
 
-    for ( ; fleet->ship != NULL; fleet->ship = next) {
-        next = fleet->ship->next;
-        free(fleet->ship);
-    }
-    if (fleet->post != NULL) {
-        free(fleet->post);
-        fleet->post = NULL;
-    }
-    if (fleet->tp != NULL) {
-        free(fleet->tp);
-        fleet->tp = NULL;
+    if (fleet == NULL || fleet->post.ship == NULL
+        || fleet->tp == NULL || fleet->ship == NULL) return -1;
+
+    if (idx < 0 || idx >= FLEET_MAXTP) return -2;
+
+    if (p1 < 0 || p1 >= fleet->npost || p2 < 0 || p2 >= fleet->npost)
+        return -3;
+
+    if (idx < fleet->ntp && fleet->tp[idx].p1 != NIL) return -4;
+
+    p1 = map_post(fleet, p1);
+    p2 = map_post(fleet, p2);
+    a = fleet->post.ship[p1];
+    b = fleet->post.ship[p2];
+    if (a > b) { n = a; a = b; b = n; }
+    len = (size_t)fleet->ship[a].npost + (a != b ? fleet->ship[b].npost : 0);
+
+    /* stack também serve a ship_drop(), que percorre a última nave */
+    mlen = max(len, (size_t)fleet->ship[fleet->nship - 1].npost);
+    list = malloc(len * sizeof(int32_t));
+    stack = malloc(mlen * sizeof(int32_t));
+    /* as listas de p1 e p2 podem ser copiadas, e o vetor de teleportes pode
+       crescer, sem alterar a frota */
+    if (list == NULL || stack == NULL
+        || !adj_reserve(fleet, p1, p1 == p2 ? 2 : 1)
+        || !adj_reserve(fleet, p2, 1) || !tp_grow(fleet, idx)) {
+        free(list); free(stack);
+        return -5;
     }
 
-    fleet->nship = 0;
-    fleet->npost = 0;
-    fleet->ntp = 0;
+    fleet->tp[idx].p1 = p1;
+    fleet->tp[idx].p2 = p2;
+    adj_insert(fleet, p1, p2);
+    adj_insert(fleet, p2, p1);
+
+    n = ship_clear(fleet, p1, a, b, list, stack);
+    ship_redo(fleet, a, fleet->ship[a].root, list, n, stack);
+    if (b != a) ship_drop(fleet, b, stack);
+    free(list); free(stack);
+    METRIC_FLUSH(fleet);
+
+    return fleet->nship;
 }
 
-/* ------------------------------------------------------------------------- *
- *
- * Definições de funções internas
- * 
- * ------------------------------------------------------------------------- */
+int32_t fleet_unlink(Fleet *fleet, int32_t idx)
+{   /* a nave do teleporte é explorada novamente a partir de cada um dos
+       postos do teleporte; a parte que não contém o primeiro posto, se
+       houver, recebe um novo id */
 
-inline Ship *add_ship(Fleet *fleet, int32_t id, int32_t root)
-{
-    Ship *ship;
+    Posts *post = &fleet->post;
+    int32_t u, v, id, n;
+    int32_t *list, *stack;
+    bool split;
 
-    ship = malloc(sizeof(Ship));
-    if (ship == NULL) return NULL;
+    if (fleet == NULL || fleet->post.ship == NULL
+        || fleet->tp == NULL || fleet->ship == NULL) return -1;
 
-    ship->id = id;
-    ship->npost = 0;
-    ship->next = fleet->ship;
-    fleet->ship = ship;
-    fleet->nship++;
-    ship->root = root;
-    ship->height = 1;
+    if (idx < 0 || idx >= fleet->ntp) return -2;
+
+    if ((u = fleet->tp[idx].p1) == NIL) return -4;
+
+    v = fleet->tp[idx].p2;
+    id = post->ship[u];
+    list = malloc(fleet->ship[id].npost * sizeof(int32_t));
+    stack = malloc(fleet->ship[id].npost * sizeof(int32_t));
+    if (list == NULL || stack == NULL
+        || (fleet->nship == fleet->mship
+            && !ship_alloc(fleet, min(2 * fleet->mship, fleet->npost)))) {
+        free(list); free(stack);
+        return -5;
+    }
 
-    return ship;
+    fleet->tp[idx].p1 = NIL;
+    adj_remove(fleet, u, v);
+    adj_remove(fleet, v, u);
+
+    n = ship_clear(fleet, u, id, id, list, stack);
+    split = post->ship[v] != NIL;   /* v não foi alcançado a partir de u */
+    ship_redo(fleet, id, u, list, n, stack);
+    if (split) {
+        n = ship_clear(fleet, v, id, id, list, stack);
+        ship_redo(fleet, add_ship(fleet, v), v, list, n, stack);
+    }
+    free(list); free(stack);
+    METRIC_FLUSH(fleet);
+
+    return fleet->nship;
 }
 
-void ship_visit(Fleet *fleet, Ship *ship)
-{   /* baseado no algoritmo de busca em profundidade com pilha */
+int32_t fleet_relabel(Fleet *fleet)
+{   /* cada nave é percorrida em pré-ordem a partir da raiz, e os postos
+       recebem ids consecutivos na ordem em que são visitados */
 
-    Post *post = &fleet->post[ship->root];
-    Post *child;
-    int32_t stack[fleet->npost];    /* pilha */
-    int32_t idx = 0;                /* índice da pilha */
-    int32_t u, v;
-    int32_t mdeg = 0;   /* grau máximo */
-    int32_t nback = 0;  /* número de arestas de retorno */
-    int32_t ntp;
+    Posts *post = &fleet->post;
+    int32_t *label, *origin, *tmp, *adj_idx, *adj_end, *adj;
+    int32_t npost, n = 0, idx, u, v;
 
-    add_post(fleet, ship, post, NIL);
-    stack[idx++] = ship->root;
+    if (fleet == NULL || fleet->post.ship == NULL
+        || fleet->tp == NULL || fleet->ship == NULL) return -1;
 
-    while (idx > 0) {
-        /* retira um posto da fila */
-        u = stack[--idx];
-        post = &fleet->post[u];
+    if (fleet->label != NULL) return 0;
+
+    METRIC_START(t0);
+    npost = fleet->npost;
+    label = malloc(npost * sizeof(int32_t));
+    origin = malloc(npost * sizeof(int32_t));
+    tmp = malloc(npost * sizeof(int32_t));
+    /* os novos vetores mantêm a capacidade dos anteriores, exceto adj,
+       cujas listas voltam a ser compactadas */
+    adj_idx = malloc((fleet->mpost + 1) * sizeof(int32_t));
+    adj_end = malloc(fleet->mpost * sizeof(int32_t));
+    adj = malloc(2 * (size_t)fleet->mtp * sizeof(int32_t));
+    if (label == NULL || origin == NULL || tmp == NULL
+        || adj_idx == NULL || adj_end == NULL || adj == NULL) {
+        free(label); free(origin); free(tmp);
+        free(adj_idx); free(adj_end); free(adj);
+        return -3;
+    }
 
-        /* percorre a lista de adjacências do posto de combate u */
-        ntp = 0;
-        for (Teleport *tp = post->tp; tp != NULL; tp = tp->next) {
-            ntp++;
-            v = tp->to;
-            child = &fleet->post[v];
-            if (child->ship == NULL) {
-                add_post(fleet, ship, child, u);
-                stack[idx++] = v;
-            } else if (child->depth < post->depth && v != post->pi) {
-                /* child é um ancestral do posto mas não é seu pai */
-                nback++;
+    /* nova numeração, com tmp como pilha; um posto é marcado com ND ao ser
+       empilhado, para que teleportes repetidos não o empilhem de novo */
+    for (int32_t i = 0; i < npost; i++) label[i] = NIL;
+    for (Ship *ship = fleet->ship; ship < fleet->ship + fleet->nship; ship++) {
+        tmp[0] = ship->root;
+        label[ship->root] = ND;
+        idx = 1;
+        while (idx > 0) {
+            u = tmp[--idx];
+            label[u] = n;
+            origin[n++] = u;
+            for (int32_t i = fleet->adj_idx[u]; i < fleet->adj_end[u]; i++) {
+                v = fleet->adj[i];
+                if (post->pi[v] == u && label[v] == NIL) {
+                    label[v] = ND;
+                    tmp[idx++] = v;
+                }
             }
         }
-        if (ntp > mdeg) mdeg = ntp;
+        ship->root = label[ship->root];
     }
-    /* classifica a nave encontrada */
-    ship_class(ship, mdeg, nback);
+
+    /* atributos dos postos; o grupo continua sendo a paridade da
+       profundidade */
+    relabel_array(post->ship, label, tmp, npost, false);
+    relabel_array(post->pi, label, tmp, npost, true);
+    relabel_array(post->depth, label, tmp, npost, false);
+    relabel_array(post->jump, label, tmp, npost, true);
+    relabel_array(post->pos, label, tmp, npost, false);
+    set_group(fleet, 0, GROUP_NWORD(npost));
+    free(tmp);
+
+    /* listas de adjacências, na mesma ordem de antes */
+    adj_idx[0] = 0;
+    for (u = 0; u < npost; u++) {
+        v = origin[u];
+        adj_end[u] = adj_idx[u];
+        for (int32_t i = fleet->adj_idx[v]; i < fleet->adj_end[v]; i++) {
+            adj[adj_end[u]++] = label[fleet->adj[i]];
+        }
+        adj_idx[u + 1] = adj_end[u];
+    }
+    img_free(fleet, fleet->adj_idx); free(fleet->adj_end);
+    free(fleet->adj_lim); img_free(fleet, fleet->adj);
+    fleet->madj = 2 * fleet->mtp;
+    fleet->adj_idx = adj_idx;
+    fleet->adj_end = adj_end;
+    fleet->adj_lim = NULL;
+    fleet->adj = adj;
+
+    for (int32_t i = 0; i < fleet->ntp; i++) {
+        if (fleet->tp[i].p1 == NIL) continue;
+        fleet->tp[i].p1 = label[fleet->tp[i].p1];
+        fleet->tp[i].p2 = label[fleet->tp[i].p2];
+    }
+    fleet->label = label;
+    fleet->origin = origin;
+
+    /* a tabela esparsa é indexada pela numeração dos postos */
+    if (fleet->lca == FLEET_LCA_RMQ && rmq_build(fleet) < 0) {
+        fleet_index(fleet, FLEET_LCA_SQRT);
+    }
+    METRIC_STOP(fleet, t0, t_relabel);
+
+    return 0;
 }
 
-inline void add_post(Fleet *fleet, Ship *ship, Post *post, int32_t pi)
+int32_t fleet_post(Fleet *fleet, int32_t p, Post *post)
 {
-    Post *parent;
+    int32_t pi, jump;
 
-    /* adiciona o posto na nave */
-    post->ship = ship;
-    ship->npost++;
+    if (fleet == NULL || fleet->post.ship == NULL || fleet->ship == NULL
+        || post == NULL) return -1;
 
-    /* monta a floresta de BP */
-    post->pi = pi;
-    if (pi == NIL) {
-        post->depth = 0;
-        post->group = 0;
-    } else {
-        parent = &fleet->post[pi];
-        post->depth = 1 + parent->depth;
-        post->group = 1 - parent->group;
+    if (p < 0 || p >= fleet->npost) return -2;
+
+    p = map_post(fleet, p);
+    pi = fleet->post.pi[p];
+    jump = fleet->post.jump[p];
+    if (fleet->origin != NULL) {
+        /* pi e jump voltam à numeração original */
+        if (pi >= 0) pi = fleet->origin[pi];
+        if (jump >= 0) jump = fleet->origin[jump];
     }
-    post->jump = ND;
+    post->ship = fleet->post.ship[p];
+    post->pi = pi;
+    post->depth = fleet->post.depth[p];
+    post->group = GROUP_OF(fleet->post.group, p);
+    post->jump = jump;
+    post->pos = fleet->post.pos[p];
 
-    /* atualiza a altura da árvore da nave, se necessário */
-    if (post->depth + 1 > ship->height) ship->height = post->depth + 1;
+    return 0;
 }
 
-inline void ship_class(Ship *ship, int32_t mdeg, int32_t nback)
+int32_t fleet_stat(Fleet *fleet, int32_t *stat)
 {
-    if (nback == 0) {
-        if (mdeg == 2) ship->type = FLEET_SCOUT;
-        else ship->type = FLEET_FRIGATE;
-    } else if (nback == 1) {
-        ship->type = FLEET_TRANSPORT;
+    if (fleet == NULL || fleet->ship == NULL) return -1;
+
+    if (stat == NULL) return -2;
+
+    for (int32_t i = 0; i < FLEET_NTYPE; i++) stat[i] = 0;
+
+    for (int32_t k = 0; k < fleet->nship; k++) stat[fleet->ship[k].type]++;
+    return fleet->nship;
+}
+
+int64_t fleet_adtm(Fleet *fleet, int32_t *p1, int32_t *p2)
+{   /* os vetores de trabalho são alocados para uma única chamada */
+
+    FleetWork *work;
+    int64_t ret;
+
+    if (fleet == NULL || fleet->post.ship == NULL || fleet->ship == NULL)
+        return -1;
+    if ((work = fleet_work_new(fleet, 1)) == NULL) return -4;
+
+    ret = fleet_work_adtm(work, p1, p2);
+    fleet_work_free(work);
+
+    return ret;
+}
+
+int32_t fleet_dist_batch(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                         int32_t n, int64_t *out)
+{
+    int32_t *q;
+    int32_t ret;
+
+    /* os teleportes não são necessários, e uma frota explorada por
+       fleet_xscan() não os mantém */
+    if (fleet == NULL || fleet->post.ship == NULL || fleet->ship == NULL)
+        return -1;
+
+    if (n < 0 || p1 == NULL || p2 == NULL || out == NULL) return -2;
+
+    METRIC_START(t0);
+    if (fleet->label == NULL) {
+        ret = batch_run(fleet, p1, p2, n, out, true);
     } else {
-        ship->type = FLEET_BOMBER;
+        if ((q = malloc(2 * (size_t)n * sizeof(int32_t))) == NULL) return -3;
+        map_pairs(fleet, p1, p2, n, q);
+        ret = batch_run(fleet, q, q + n, n, out, true);
+        free(q);
     }
+    METRIC_STOP(fleet, t0, t_batch);
+    METRIC_FLUSH(fleet);
+
+    return ret;
 }
 
-int64_t get_dist(Fleet *fleet, int32_t p1, int32_t p2)
-{   /* assume que todas as naves correspondem exatamente às características 
-       até então conhecidas do seu tipo */
-    
-    Post *post1 = &fleet->post[p1];
-    Post *post2 = &fleet->post[p2];
-    Ship *ship = post1->ship;
-    int32_t lca;
-    Post *post_lca;
-    int32_t i, j, k;
+int64_t fleet_query_init(FleetQuery *query, Fleet *fleet, const int32_t *p1,
+                         const int32_t *p2)
+{   /* as distâncias iniciais são calculadas por fleet_dist_batch(); o
+       atributo jump de todas as fragatas é montado de antemão, de modo que
+       get_dist() não falhe durante as atualizações */
+
+    int32_t npost, nship;
+    int64_t *d;
+    int32_t ret;
+
+    if (query == NULL || fleet == NULL || fleet->post.ship == NULL
+        || fleet->ship == NULL) return -1;
+
+    npost = fleet->npost;
+    nship = fleet->nship;
+    query->fleet = fleet;
+    query->target = malloc(npost * sizeof(int32_t));
+    query->dist = malloc(npost * sizeof(int32_t));
+    query->s = calloc(nship, sizeof(int64_t));
+    query->heap = malloc(nship * sizeof(int32_t));
+    query->hpos = malloc(nship * sizeof(int32_t));
+    d = malloc(npost * sizeof(int64_t));
+    if (query->target == NULL || query->dist == NULL || query->s == NULL
+        || query->heap == NULL || query->hpos == NULL || d == NULL) {
+        free(d);
+        fleet_query_free(query);
+        return -4;
+    }
 
-    /* se p1 e p2 não estão na mesma nave */
-    if (ship != post2->ship) return FLEET_INF;
+    if ((ret = fleet_dist_batch(fleet, p1, p2, npost, d)) < 0) {
+        free(d);
+        fleet_query_free(query);
+        return ret == -3 ? -4 : -2;
+    }
+    for (int32_t i = 0; i < npost; i++) {
+        if (d[i] == -1 || d[i] == FLEET_INF) {
+            /* p1[i] e p2[i] não estão na mesma nave ou a nave é de tipo
+               desconhecido */
+            free(d);
+            fleet_query_free(query);
+            return -3;
+        }
+    }
+    for (int32_t i = 0, u; i < npost; i++) {
+        u = map_post(fleet, p1[i]);
+        query->target[u] = map_post(fleet, p2[i]);
+        query->dist[u] = d[i];
+        query->s[fleet->post.ship[u]] += d[i];
+    }
+    free(d);
+
+    for (int32_t k = 0; k < nship; k++) {
+        if (fleet->ship[k].type == FLEET_FRIGATE && fleet->lca == FLEET_LCA_SQRT
+            && fleet->post.jump[fleet->ship[k].root] == ND
+            && set_jump(fleet, &fleet->ship[k]) < 0) {
+            fleet_query_free(query);
+            return -4;
+        }
+    }
 
-    switch (ship->type)
-    {   /* para entender as fórmulas, consulte a documentação */
-        case FLEET_SCOUT:
-        case FLEET_FRIGATE:
-            if (post1->jump == ND) 
-                set_jump(fleet, ship->root, sqrt(ship->height));
-            lca = get_lca(fleet, p1, p2);
-            post_lca = &fleet->post[lca];
-            return post1->depth + post2->depth - 2 * post_lca->depth;
+    /* heap montado de baixo para cima */
+    for (int32_t k = 0; k < nship; k++) {
+        query->heap[k] = k;
+        query->hpos[k] = k;
+    }
+    for (int32_t i = nship / 2 - 1; i >= 0; i--) heap_down(query, i);
 
-        case FLEET_TRANSPORT:
-            i = min(post1->depth, post2->depth);
-            j = max(post1->depth, post2->depth);
-            k = ship->height;
-            return min(j - i, k - j + i);
+    return fleet_query_adtm(query);
+}
 
-        case FLEET_BOMBER:
-            if (post1->group == post2->group) {
-                if (post1 == post2) return 0;
-                else return 2;
-            }
-            return 1;
+int64_t fleet_query_update(FleetQuery *query, const int32_t *post,
+                           const int32_t *target, int32_t n)
+{   /* todas as distâncias são calculadas antes de qualquer alteração, de modo
+       que uma falha de get_dist() não deixe a consulta pela metade */
 
-        default:
-            /* Erro! Nave de tipo desconhecido */
-            return -1;
+    Fleet *fleet;
+    int32_t u, v, k;
+    int64_t *d;
+
+    if (query == NULL || query->fleet == NULL || query->s == NULL) return -1;
+
+    if (n < 0 || post == NULL || target == NULL) return -2;
+
+    fleet = query->fleet;
+    for (int32_t i = 0; i < n; i++) {
+        if (post[i] < 0 || post[i] >= fleet->npost
+            || target[i] < 0 || target[i] >= fleet->npost) return -2;
+        if (fleet->post.ship[map_post(fleet, post[i])]
+            != fleet->post.ship[map_post(fleet, target[i])]) return -3;
+    }
+    if (n == 0) return fleet_query_adtm(query);
+
+    if ((d = malloc(n * sizeof(int64_t))) == NULL) return -4;
+    for (int32_t i = 0; i < n; i++) {
+        d[i] = get_dist(fleet, map_post(fleet, post[i]),
+                        map_post(fleet, target[i]));
+        if (d[i] < 0) {
+            free(d);
+            METRIC_FLUSH(fleet);
+            return -4;
+        }
+    }
+
+    for (int32_t i = 0; i < n; i++) {
+        u = map_post(fleet, post[i]);
+        v = map_post(fleet, target[i]);
+        if (v == query->target[u]) continue;
+        k = fleet->post.ship[u];
+        query->s[k] += d[i] - query->dist[u];
+        query->target[u] = v;
+        query->dist[u] = d[i];
+        heap_fix(query, query->hpos[k]);
     }
+    free(d);
+    METRIC_FLUSH(fleet);
+
+    return fleet_query_adtm(query);
 }
 
-void set_jump(Fleet *fleet, int32_t p, int32_t block_sz)
-{   /* configura o atributo jump dos postos com base na decomposição
-       SQRT da árvore que representa a nave */
+int64_t fleet_query_adtm(FleetQuery *query)
+{
+    if (query == NULL || query->fleet == NULL || query->s == NULL) return -1;
 
-    Post *post = &fleet->post[p];
-    int32_t pi;
+    return query->s[query->heap[0]] / 2;
+}
 
-    pi = post->pi;
-    if (post->depth % block_sz == 0) {
-        /* o posto está no primeiro nível do bloco */
-        post->jump = pi;
-    } else {
-        /* post->pi = NIL implica que post está no primeiro nível do bloco */
-        post->jump = fleet->post[pi].jump;
+void fleet_query_free(FleetQuery *query)
+{
+    if (query == NULL) return;
+
+    free(query->target); free(query->dist); free(query->s);
+    free(query->heap); free(query->hpos);
+    query->fleet = NULL;
+    query->target = NULL;
+    query->dist = NULL;
+    query->s = NULL;
+    query->heap = NULL;
+    query->hpos = NULL;
+}
+
+int32_t fleet_save(Fleet *fleet, const char *path)
+{   /* a imagem é gravada num arquivo temporário que depois substitui path,
+       de modo que uma imagem mapeada por fleet_load(), mesmo a da própria
+       frota, nunca é truncada */
+
+    ImgHeader hdr;
+    FILE *file;
+    char *tmp;
+    bool ok;
+
+    if (fleet == NULL || fleet->post.ship == NULL
+        || fleet->tp == NULL || fleet->ship == NULL) return -1;
+
+    if (path == NULL || (tmp = malloc(strlen(path) + 5)) == NULL) return -2;
+
+    sprintf(tmp, "%s.tmp", path);
+    if ((file = fopen(tmp, "wb")) == NULL) { free(tmp); return -2; }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, IMG_MAGIC, sizeof(hdr.magic));
+    hdr.version = FLEET_IMGVER;
+    hdr.bom = IMG_BOM;
+    hdr.nship = fleet->nship;
+    hdr.npost = fleet->npost;
+    hdr.ntp = fleet->ntp;
+    hdr.label = fleet->label != NULL;
+    ok = img_write(file, &hdr, sizeof(hdr));
+    ok = ok && img_write(file, fleet->ship, fleet->nship * sizeof(Ship));
+
+    ok = ok && img_write(file, fleet->post.ship,
+                         fleet->npost * sizeof(int32_t));
+    ok = ok && img_write(file, fleet->post.pi, fleet->npost * sizeof(int32_t));
+    ok = ok && img_write(file, fleet->post.depth,
+                         fleet->npost * sizeof(int32_t));
+    ok = ok && img_write(file, fleet->post.jump,
+                         fleet->npost * sizeof(int32_t));
+    ok = ok && img_write(file, fleet->post.pos,
+                         fleet->npost * sizeof(int32_t));
+    ok = ok && img_write(file, fleet->post.group,
+                         GROUP_NWORD(fleet->npost) * sizeof(uint64_t));
+    ok = ok && img_write(file, fleet->tp, fleet->ntp * sizeof(Teleport));
+    ok = ok && img_adj(file, fleet);
+    if (fleet->label != NULL) {
+        ok = ok && img_write(file, fleet->label,
+                             fleet->npost * sizeof(int32_t));
     }
-    /* configura outros postos da nave a partir desse posto */
-    for (Teleport *tp = post->tp; tp != NULL; tp = tp->next) {
-        if (fleet->post[tp->to].pi == p) set_jump(fleet, tp->to, block_sz);
+
+    if (fclose(file) != 0) ok = false;
+    if (ok && rename(tmp, path) != 0) ok = false;
+    if (!ok) remove(tmp);
+    free(tmp);
+
+    return ok ? 0 : -2;
+}
+
+int32_t fleet_load(Fleet *fleet, const char *path)
+{
+    size_t off[IMG_NSEC + 1];
+    ImgHeader hdr;
+    struct stat st;
+    char *img;
+    int32_t ret;
+    int fd;
+
+    if (fleet == NULL) return -1;
+
+    if (path == NULL || (fd = open(path, O_RDONLY)) < 0) return -2;
+
+    if (fstat(fd, &st) != 0) { close(fd); return -2; }
+    if (st.st_size < (off_t)sizeof(hdr)) { close(fd); return -3; }
+
+    /* as páginas alteradas, como as do atributo jump montado sob demanda,
+       são copiadas pelo sistema, e o arquivo não muda */
+    img = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (img == MAP_FAILED) return -2;
+
+    /* valida o cabeçalho e o tamanho do arquivo */
+    memcpy(&hdr, img, sizeof(hdr));
+    if (memcmp(hdr.magic, IMG_MAGIC, sizeof(hdr.magic)) != 0
+        || hdr.version != FLEET_IMGVER || hdr.bom != IMG_BOM
+        || hdr.npost < FLEET_MINPOST || hdr.npost > FLEET_MAXPOST
+        || hdr.ntp < FLEET_MINTP || hdr.ntp > FLEET_MAXTP
+        || hdr.nship < 1 || hdr.nship > hdr.npost
+        || (hdr.label != 0 && hdr.label != 1)
+        || img_layout(hdr.nship, hdr.npost, hdr.ntp, hdr.label, off)
+           != (size_t)st.st_size) {
+        munmap(img, st.st_size);
+        return -3;
     }
+    ret = img_load(fleet, img, st.st_size, off);
+    if (ret < 0) { fleet_free(fleet); return ret; }
+
+    return fleet->nship;
 }
 
-int32_t get_lca(Fleet *fleet, int32_t p1, int32_t p2)
-{   /* retorna o ancentral comum mais baixo entre p1 e p2 com base na 
-       decomposição SQRT da árvore que representa a nave */
+int64_t fleet_padtm(Fleet *fleet, int32_t *p1, int32_t *p2, int32_t nthread)
+{   /* os vetores de trabalho são alocados para uma única chamada; sem
+       memória para a versão paralela, tenta-se a sequencial */
+
+    FleetWork *work;
+    int64_t ret;
+
+    if (fleet == NULL || fleet->post.ship == NULL || fleet->ship == NULL)
+        return -1;
+    if ((work = fleet_work_new(fleet, nthread)) == NULL
+        && (work = fleet_work_new(fleet, 1)) == NULL) return -4;
 
-    Post *post = fleet->post;
+    ret = fleet_work_adtm(work, p1, p2);
+    fleet_work_free(work);
 
-    while (post[p1].jump != post[p2].jump) {
-        if (post[p1].depth > post[p2].depth) p1 = post[p1].jump;
-        else p2 = post[p2].jump;
+    return ret;
+}
+
+FleetWork *fleet_work_new(Fleet *fleet, int32_t nthread)
+{   /* os vetores da versão paralela só são alocados se a frota comporta
+       mais de uma thread */
+
+    FleetWork *work;
+    int32_t npost, nship, nblock;
+
+    /* os teleportes não são necessários, e uma frota explorada por
+       fleet_xscan() não os mantém */
+    if (fleet == NULL || fleet->post.ship == NULL || fleet->ship == NULL)
+        return NULL;
+
+    if ((work = calloc(1, sizeof(FleetWork))) == NULL) return NULL;
+
+    npost = fleet->npost;
+    nship = fleet->nship;
+    work->fleet = fleet;
+    work->nship = nship;
+    work->nthread = max(1, min(nthread, npost / PAR_MINPOST));
+    work->map = malloc(2 * (size_t)npost * sizeof(int32_t));
+    work->qoff = malloc((nship + 1) * sizeof(int32_t));
+    work->qidx = malloc(npost * sizeof(int32_t));
+    work->bound = malloc(nship * sizeof(int64_t));
+    work->dist = malloc(npost * sizeof(int64_t));
+    work->cand = malloc(nship * sizeof(ShipBound));
+    if (work->map == NULL || work->qoff == NULL || work->qidx == NULL
+        || work->bound == NULL || work->dist == NULL || work->cand == NULL) {
+        fleet_work_free(work);
+        return NULL;
     }
-    while (p1 != p2) {
-        if (post[p1].depth > post[p2].depth) p1 = post[p1].pi;
-        else p2 = post[p2].pi;
+    if (work->nthread == 1) return work;
+
+    /* há no máximo npost / PAR_BLOCK blocos cheios e um parcial por nave */
+    nblock = npost / PAR_BLOCK + nship;
+    work->blk = malloc(nblock * sizeof(int32_t));
+    work->blk_ship = malloc(nblock * sizeof(int32_t));
+    work->order = calloc(nship, sizeof(int32_t));
+    work->cnt = malloc((npost + 1) * sizeof(int32_t));
+    work->s = malloc(nship * sizeof(*work->s));
+    work->r = malloc(nship * sizeof(*work->r));
+    work->task = malloc(work->nthread * sizeof(AdtmTask));
+    work->thread = malloc(work->nthread * sizeof(TaskThread));
+    if (work->blk == NULL || work->blk_ship == NULL || work->order == NULL
+        || work->cnt == NULL || work->s == NULL || work->r == NULL
+        || work->task == NULL || work->thread == NULL) {
+        fleet_work_free(work);
+        return NULL;
     }
-    return p1;
-}
\ No newline at end of file
+    return work;
+}
+
+int64_t fleet_work_adtm(FleetWork *work, int32_t *p1, int32_t *p2)
+{
+    Fleet *fleet;
+    int64_t ret;
+
+    if (work == NULL || work->fleet->nship != work->nship) return -1;
+
+    fleet = work->fleet;
+    METRIC_START(t0);
+    if (fleet->label != NULL) {
+        map_pairs(fleet, p1, p2, fleet->npost, work->map);
+        p1 = work->map;
+        p2 = work->map + fleet->npost;
+    }
+    ret = padtm_run(fleet, p1, p2, work);
+    METRIC_STOP(fleet, t0, t_adtm);
+    METRIC_FLUSH(fleet);
+
+    return ret;
+}
+
+void fleet_work_free(FleetWork *work)
+{
+    if (work == NULL) return;
+
+    free(work->map); free(work->qoff); free(work->qidx); free(work->bound);
+    free(work->dist); free(work->cand); free(work->blk); free(work->blk_ship);
+    free(work->order); free(work->cnt); free(work->s); free(work->r);
+    free(work->task); free(work->thread);
+    free(work);
+}
+
+int32_t fleet_index(Fleet *fleet, int32_t method)
+{
+    if (fleet == NULL || fleet->post.ship == NULL
+        || fleet->tp == NULL || fleet->ship == NULL) return -1;
+
+    if (method != FLEET_LCA_SQRT && method != FLEET_LCA_RMQ) return -2;
+
+    METRIC_START(t0);
+    if (method == FLEET_LCA_RMQ && fleet->lca != FLEET_LCA_RMQ) {
+        if (rmq_build(fleet) < 0) return -3;
+    } else if (method == FLEET_LCA_SQRT) {
+        /* o atributo jump continua sendo montado sob demanda */
+        free(fleet->lca_pre); free(fleet->lca_tbl);
+        fleet->lca_pre = NULL;
+        fleet->lca_tbl = NULL;
+        fleet->lca_n = 0;
+        fleet->lca_nlev = 0;
+    }
+    fleet->lca = method;
+    METRIC_STOP(fleet, t0, t_index);
+
+    return 0;
+}
+
+size_t fleet_index_size(Fleet *fleet)
+{
+    if (fleet == NULL) return 0;
+
+    if (fleet->lca == FLEET_LCA_RMQ) {
+        return (size_t)fleet->npost * sizeof(int32_t)
+               + (size_t)fleet->lca_nlev * fleet->lca_n * sizeof(int32_t);
+    }
+    return (size_t)fleet->npost * sizeof(int32_t);
+}
+
+int32_t fleet_metrics(Fleet *fleet, FILE *out)
+{
+    FleetMetrics *m;
+
+    if (fleet == NULL || fleet->post.ship == NULL) return -1;
+
+    if (out == NULL) return -2;
+
+    m = &fleet->metrics;
+    fprintf(out, "{\"ativo\": %s, \"tempo\": {\"exploracao\": %.6f, "
+            "\"renumeracao\": %.6f, \"indice\": %.6f, \"vantagem\": %.6f, "
+            "\"distancias\": %.6f}, ", METRIC_ON ? "true" : "false",
+            m->t_scan, m->t_relabel, m->t_index, m->t_adtm, m->t_batch);
+    fprintf(out, "\"arestas\": %" PRId64 ", \"lca_saltos\": %" PRId64
+            ", \"lca_pais\": %" PRId64 ", \"jump_naves\": %" PRId64 ", ",
+            m->edges, m->lca_jump, m->lca_parent, m->jump_ships);
+    fprintf(out, "\"consultas\": {\"reconhecimento\": %" PRId64
+            ", \"fragata\": %" PRId64 ", \"bombardeiro\": %" PRId64
+            ", \"transportador\": %" PRId64 "}, ", m->query[FLEET_SCOUT],
+            m->query[FLEET_FRIGATE], m->query[FLEET_BOMBER],
+            m->query[FLEET_TRANSPORT]);
+    fprintf(out, "\"podas\": %" PRId64 ", \"paradas\": %" PRId64 "}",
+            m->pruned, m->early);
+
+    return ferror(out) ? -3 : 0;
+}
+
+void fleet_free(Fleet *fleet)
+{
+    if (fleet == NULL) return;
+
+    scan_free(fleet);
+    img_unmap(fleet);
+    post_free(&fleet->post);
+    if (fleet->tp != NULL) {
+        free(fleet->tp);
+        fleet->tp = NULL;
+    }
+    if (fleet->adj_idx != NULL) {
+        free(fleet->adj_idx);
+        fleet->adj_idx = NULL;
+    }
+    if (fleet->adj_end != NULL) {
+        free(fleet->adj_end);
+        fleet->adj_end = NULL;
+    }
+    if (fleet->adj_lim != NULL) {
+        free(fleet->adj_lim);
+        fleet->adj_lim = NULL;
+    }
+    if (fleet->adj != NULL) {
+        free(fleet->adj);
+        fleet->adj = NULL;
+    }
+    fleet->npost = 0;
+    fleet->mpost = 0;
+    fleet->ntp = 0;
+    fleet->mtp = 0;
+    fleet->madj = 0;
+}
+
+/* ------------------------------------------------------------------------- *
+ *
+ * Definições de funções internas
+ *
+ * ------------------------------------------------------------------------- */
+
+int64_t adtm_run(Fleet *fleet, int32_t *p1, int32_t *p2, FleetWork *work)
+{   /* fleet_adtm() com os postos na numeração interna e os vetores de work:
+       primeiro, calcula para cada nave uma cota inferior da soma das
+       distâncias, que é exata exceto nas fragatas; depois, avalia as
+       fragatas por completo, em ordem crescente de cota, até que a cota da
+       próxima não seja menor que a menor soma encontrada */
+
+    int64_t *s = work->bound;       /* cota inferior da soma por nave */
+    int64_t m = FLEET_INF;          /* menor soma encontrada */
+    int64_t *dist = work->dist;     /* distância, ou cota, de cada par */
+    ShipBound *cand = work->cand;   /* fragatas que ainda podem reduzir m */
+    int32_t *qoff = work->qoff;     /* pares agrupados por nave */
+    int32_t *qidx = work->qidx;
+    int32_t ncand = 0, c, k;
+    int64_t ret;
+
+    if ((ret = batch_run(fleet, p1, p2, fleet->npost, dist, false)) < 0) {
+        return ret == -3 ? -4 : ret;
+    }
+    for (k = 0; k < fleet->nship; k++) s[k] = 0;
+    for (int32_t i = 0; i < fleet->npost; i++) {
+        if (dist[i] == -1 || dist[i] == FLEET_INF) {
+            /* p1[i] e p2[i] não estão na mesma nave ou a nave é de tipo
+               desconhecido */
+            return -3;
+        }
+        s[fleet->post.ship[p1[i]]] += dist[i];
+    }
+
+    /* a cota de uma fragata é exata se todos os seus pares estão no lugar */
+    for (k = 0; k < fleet->nship; k++) {
+        if ((fleet->ship[k].type != FLEET_FRIGATE || s[k] == 0) && s[k] < m)
+            m = s[k];
+    }
+    for (k = 0; k < fleet->nship; k++) {
+        if (fleet->ship[k].type == FLEET_FRIGATE && s[k] < m) ncand++;
+        else if (fleet->ship[k].type == FLEET_FRIGATE) METRIC_ADD(pruned, 1);
+    }
+    if (ncand == 0 || m <= 1) {
+        if (m <= 1) METRIC_ADD(early, 1);
+        return m / 2;
+    }
+
+    ncand = 0;
+    for (k = 0; k < fleet->nship; k++) {
+        if (fleet->ship[k].type == FLEET_FRIGATE && s[k] < m) {
+            cand[ncand].bound = s[k];
+            cand[ncand++].id = k;
+        }
+    }
+    qsort(cand, ncand, sizeof(ShipBound), bound_cmp);
+    bucket_pairs(fleet, p1, p2, qoff, qidx);
+
+    /* m <= 1 é a menor cota inferior possível */
+    for (c = 0; c < ncand && cand[c].bound < m && m > 1; c++) {
+        k = cand[c].id;
+        ret = ship_sum(fleet, p1, p2, qidx + qoff[k], qoff[k + 1] - qoff[k],
+                       m);
+        if (ret < 0) { m = -4; break; }
+        if (ret < m) m = ret;
+        else METRIC_ADD(pruned, 1);
+    }
+    if (m >= 0 && m <= 1 && c < ncand) METRIC_ADD(early, 1);
+    else if (m >= 0) METRIC_ADD(pruned, ncand - c);
+
+    return m < 0 ? m : m / 2;
+}
+
+int32_t batch_run(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                  int32_t n, int64_t *out, bool exact)
+{   /* fleet_dist_batch() com os postos na numeração interna: as consultas são
+       processadas em blocos de até DIST_BLOCK consultas; em cada bloco, elas
+       são agrupadas por tipo de nave com uma ordenação por contagem, e cada
+       grupo é respondido por um laço próprio, sem desvios que dependam do
+       tipo. Se exact é falso, as consultas às fragatas recebem apenas uma
+       cota inferior da distância: a diferença de profundidade dos postos, ou
+       1 se ela é nula */
+
+    Posts *post = &fleet->post;
+    uint8_t key[DIST_BLOCK];    /* grupo de cada consulta do bloco */
+    int32_t qidx[DIST_BLOCK];   /* consultas do grupo t: qidx[qoff[t]..] */
+    int32_t qoff[QRY_NKEY + 1];
+    const int32_t *b1, *b2;     /* pares do bloco */
+    int64_t *bout;              /* respostas do bloco */
+    int32_t m, u, v, t;
+    bool tree = false;  /* há consultas pendentes em fragatas */
+
+    for (int32_t i = 0; i < n; i++) {
+        u = p1[i]; v = p2[i];
+        if (u < 0 || u >= fleet->npost || v < 0 || v >= fleet->npost)
+            return -2;
+    }
+
+    for (int32_t first = 0; first < n; first += m) {
+        m = min(n - first, DIST_BLOCK);
+        b1 = p1 + first;
+        b2 = p2 + first;
+        bout = out + first;
+        for (t = 0; t <= QRY_NKEY; t++) qoff[t] = 0;
+        for (int32_t i = 0; i < m; i++) {
+            u = b1[i]; v = b2[i];
+            if (u == v) {
+                bout[i] = 0;
+                t = QRY_DONE;
+            } else if (post->ship[u] != post->ship[v]) {
+                bout[i] = FLEET_INF;
+                t = QRY_DONE;
+            } else {
+                t = fleet->ship[post->ship[u]].type;
+                /* tipo desconhecido ou transportador que não é um ciclo
+                   simples; a comparação de pos é feita sem desvio */
+                if ((uint32_t)t >= FLEET_NTYPE) t = QRY_OTHER;
+                t = (t == FLEET_TRANSPORT) & (post->pos[u] == NIL)
+                    ? QRY_OTHER : t;
+            }
+            key[i] = t;
+            qoff[t + 1]++;
+        }
+        for (t = 0; t < QRY_NKEY; t++) qoff[t + 1] += qoff[t];
+
+        /* qoff[t] avança até o fim do grupo t e depois é restaurado */
+        for (int32_t i = 0; i < m; i++) qidx[qoff[key[i]]++] = i;
+        for (t = QRY_NKEY; t > 0; t--) qoff[t] = qoff[t - 1];
+        qoff[0] = 0;
+
+        for (t = 0; t < FLEET_NTYPE; t++) {
+            METRIC_ADD(query[t], qoff[t + 1] - qoff[t]);
+            if (t == FLEET_FRIGATE) continue;
+            dist_bucket(fleet, b1, b2, qidx + qoff[t], qoff[t + 1] - qoff[t],
+                        t, bout);
+        }
+        for (int32_t k = qoff[QRY_OTHER]; k < qoff[QRY_OTHER + 1]; k++) {
+            bout[qidx[k]] = get_dist(fleet, b1[qidx[k]], b2[qidx[k]]);
+        }
+        for (int32_t k = qoff[FLEET_FRIGATE];
+             k < qoff[FLEET_FRIGATE + 1]; k++) {
+            if (exact && fleet->adj == NULL) {
+                /* sem listas de adjacências, após fleet_xscan(), o atributo
+                   jump já está montado */
+                bout[qidx[k]] = get_dist(fleet, b1[qidx[k]], b2[qidx[k]]);
+            } else if (exact) {
+                /* respondida depois, por batch_tree() */
+                bout[qidx[k]] = ND;
+                tree = true;
+            } else {
+                t = post->depth[b1[qidx[k]]] - post->depth[b2[qidx[k]]];
+                bout[qidx[k]] = max(abs(t), 1);
+            }
+        }
+    }
+
+    return tree ? batch_tree(fleet, p1, p2, n, out) : 0;
+}
+
+int64_t ship_sum(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                 const int32_t *qidx, int32_t n, int64_t m)
+{   /* soma as distâncias dos pares qidx[0..n-1], todos de uma mesma nave,
+       parando assim que a soma atinge m; retorna -1 se get_dist() falhou */
+
+    int64_t s = 0, d;
+
+    for (int32_t k = 0; k < n && s < m; k++) {
+        if ((d = get_dist(fleet, p1[qidx[k]], p2[qidx[k]])) < 0) return -1;
+        s += d;
+    }
+    return s;
+}
+
+int bound_cmp(const void *a, const void *b)
+{   /* ordem crescente de cota para qsort() */
+
+    const ShipBound *x = a, *y = b;
+
+    return (x->bound > y->bound) - (x->bound < y->bound);
+}
+
+int64_t padtm_run(Fleet *fleet, int32_t *p1, int32_t *p2, FleetWork *work)
+{   /* fleet_padtm() com os postos na numeração interna e os vetores de work:
+       os pares são agrupados por nave e divididos em blocos de até
+       PAR_BLOCK pares, distribuídos dinamicamente entre as threads,
+       começando pelas naves com mais pares */
+
+    Adtm adtm;
+    AdtmTask *task = work->task;
+    int32_t npost, nship, nblock, nthread = work->nthread;
+    int32_t *order = work->order, *cnt = work->cnt;
+    int64_t ret;
+
+    if (nthread <= 1) return adtm_run(fleet, p1, p2, work);
+
+    npost = fleet->npost;
+    nship = fleet->nship;
+    adtm.qoff = work->qoff;
+    adtm.qidx = work->qidx;
+    adtm.s = work->s;
+    adtm.r = work->r;
+    adtm.blk = work->blk;
+    adtm.blk_ship = work->blk_ship;
+    if ((ret = bucket_pairs(fleet, p1, p2, adtm.qoff, adtm.qidx)) < 0)
+        return ret;
+
+    /* ordena as naves por número decrescente de pares fora do lugar */
+    for (int32_t i = 0; i <= npost; i++) cnt[i] = 0;
+    for (int32_t k = 0; k < nship; k++) cnt[adtm.qoff[k + 1] - adtm.qoff[k]]++;
+    for (int32_t i = npost - 1; i >= 0; i--) cnt[i] += cnt[i + 1];
+    for (int32_t k = nship - 1; k >= 0; k--) {
+        order[--cnt[adtm.qoff[k + 1] - adtm.qoff[k]]] = k;
+    }
+    if (adtm.qoff[order[nship - 1] + 1] == adtm.qoff[order[nship - 1]]) {
+        /* uma nave já tem todos os tripulantes nos postos corretos */
+        METRIC_ADD(early, 1);
+        return 0;
+    }
+
+    /* divide os pares de cada nave em blocos */
+    nblock = 0;
+    for (int32_t i = 0, k; i < nship; i++) {
+        k = order[i];
+        atomic_init(&adtm.s[k], 0);
+        atomic_init(&adtm.r[k], 0);
+        for (int32_t q = adtm.qoff[k]; q < adtm.qoff[k + 1]; q += PAR_BLOCK) {
+            adtm.blk[nblock] = q;
+            adtm.blk_ship[nblock++] = k;
+            atomic_fetch_add_explicit(&adtm.r[k], 1, memory_order_relaxed);
+        }
+    }
+    adtm.nblock = nblock;
+    adtm.fleet = fleet;
+    adtm.p1 = p1;
+    adtm.p2 = p2;
+    atomic_init(&adtm.m, FLEET_INF);
+    atomic_init(&adtm.error, false);
+    for (int32_t i = 0; i < nthread; i++) {
+        task[i].adtm = &adtm;
+        task[i].id = i;
+    }
+
+    /* o atributo jump das naves em árvore é configurado antes, para que
+       blocos de uma mesma nave possam ser processados em paralelo */
+    atomic_init(&adtm.next, 0);
+    atomic_init(&adtm.nomem, false);
+    run_tasks(task, sizeof(AdtmTask), nthread, adtm_jump,
+              work->thread);
+    if (atomic_load(&adtm.nomem)) {
+        /* sem memória para montar o atributo jump de alguma nave */
+        return adtm_run(fleet, p1, p2, work);
+    }
+    atomic_init(&adtm.next, 0);
+    run_tasks(task, sizeof(AdtmTask), nthread, adtm_sum,
+              work->thread);
+
+    if (atomic_load(&adtm.error)) return -3;
+
+    return atomic_load(&adtm.m) / 2;
+}
+
+void map_pairs(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+               int32_t n, int32_t *q)
+{   /* grava no vetor q, de 2 * n posições, os postos p1[0..n-1] seguidos dos
+       postos p2[0..n-1], traduzidos para a numeração interna; ids fora dos
+       limites são mantidos, para que sejam rejeitados adiante */
+
+    for (int32_t i = 0; i < n; i++) {
+        q[i] = map_post(fleet, p1[i]);
+        q[n + i] = map_post(fleet, p2[i]);
+    }
+}
+
+inline int32_t map_post(Fleet *fleet, int32_t p)
+{   /* traduz o id original p para a numeração interna */
+
+    if (fleet->label == NULL || p < 0 || p >= fleet->npost) return p;
+
+    return fleet->label[p];
+}
+
+void relabel_array(int32_t *a, const int32_t *label, int32_t *tmp,
+                   int32_t n, bool ids)
+{   /* move o atributo a[i] de cada posto i para a posição label[i]; se ids é
+       verdadeiro, os valores de a que são postos também são traduzidos */
+
+    int32_t x;
+
+    for (int32_t i = 0; i < n; i++) {
+        x = a[i];
+        if (ids && x >= 0) x = label[x];
+        tmp[label[i]] = x;
+    }
+    memcpy(a, tmp, n * sizeof(int32_t));
+}
+
+void pack_adj(Fleet *fleet)
+{   /* monta as listas de adjacências compactadas a partir do vetor de
+       teleportes, com os destinos de cada posto em ordem decrescente de
+       índice do teleporte */
+
+    int32_t *adj_idx = fleet->adj_idx;
+    int32_t *adj = fleet->adj;
+    Teleport *tp;
+
+    /* adj_idx[p] recebe o grau do posto p */
+    for (int32_t i = 0; i <= fleet->npost; i++) adj_idx[i] = 0;
+    for (int32_t i = 0; i < fleet->ntp; i++) {
+        tp = &fleet->tp[i];
+        if (tp->p1 == NIL) continue;
+        adj_idx[tp->p1]++;
+        adj_idx[tp->p2]++;
+    }
+    /* adj_idx[p] recebe o fim da lista de adjacências do posto p */
+    for (int32_t i = 1; i <= fleet->npost; i++) adj_idx[i] += adj_idx[i - 1];
+
+    /* preenche cada lista do fim para o início, de modo que, ao final,
+       adj_idx[p] aponta para o início da lista do posto p */
+    for (int32_t i = 0; i < fleet->ntp; i++) {
+        tp = &fleet->tp[i];
+        if (tp->p1 == NIL) continue;
+        adj[--adj_idx[tp->p1]] = tp->p2;
+        adj[--adj_idx[tp->p2]] = tp->p1;
+    }
+    for (int32_t i = 0; i < fleet->npost; i++) {
+        fleet->adj_end[i] = adj_idx[i + 1];
+    }
+    free(fleet->adj_lim);
+    fleet->adj_lim = NULL;
+}
+
+int32_t bucket_pairs(Fleet *fleet, int32_t *p1, int32_t *p2,
+                     int32_t *qoff, int32_t *qidx)
+{   /* valida os pares (p1[i], p2[i]) e agrupa os índices daqueles com
+       p1[i] != p2[i] por nave, em ordem crescente de índice dentro de cada
+       nave: os pares da nave de id k ficam em qidx[qoff[k]], ...,
+       qidx[qoff[k + 1] - 1]; retorna -2 ou -3, como fleet_adtm(), se algum
+       par é inválido */
+
+    int32_t npost = fleet->npost;
+    int32_t *ship = fleet->post.ship;
+    int32_t u, v;
+
+    for (int32_t k = 0; k <= fleet->nship; k++) qoff[k] = 0;
+    for (int32_t i = 0; i < npost; i++) {
+        u = p1[i]; v = p2[i];
+        if (u < 0 || u >= npost || v < 0 || v >= npost) return -2;
+        if (ship[u] != ship[v]) return -3;
+        if (u != v) qoff[ship[u] + 1]++;
+    }
+    for (int32_t k = 0; k < fleet->nship; k++) qoff[k + 1] += qoff[k];
+
+    /* qoff[k] avança até o fim do grupo k e depois é restaurado */
+    for (int32_t i = 0; i < npost; i++) {
+        if (p1[i] != p2[i]) qidx[qoff[ship[p1[i]]]++] = i;
+    }
+    for (int32_t k = fleet->nship; k > 0; k--) qoff[k] = qoff[k - 1];
+    qoff[0] = 0;
+
+    return 0;
+}
+
+void *adtm_jump(void *arg)
+{   /* configura o atributo jump das fragatas que ainda não o têm */
+
+    AdtmTask *task = arg;
+    Adtm *adtm = task->adtm;
+    Fleet *fleet = adtm->fleet;
+    Ship *ship;
+    int32_t id;
+
+    while ((id = atomic_fetch_add(&adtm->next, 1)) < fleet->nship) {
+        ship = &fleet->ship[id];
+        if (ship->type == FLEET_FRIGATE && fleet->lca == FLEET_LCA_SQRT
+            && fleet->post.jump[ship->root] == ND
+            && set_jump(fleet, ship) < 0) {
+            atomic_store(&adtm->nomem, true);
+        }
+    }
+    METRIC_FLUSH(fleet);
+    return NULL;
+}
+
+void *adtm_sum(void *arg)
+{   /* processa blocos de pares até que não haja mais blocos ou até que a
+       menor cota inferior possível seja encontrada */
+
+    AdtmTask *task = arg;
+    Adtm *adtm = task->adtm;
+    int32_t b, id, q, last;
+    int64_t s, d;
+
+    while ((b = atomic_fetch_add(&adtm->next, 1)) < adtm->nblock) {
+        id = adtm->blk_ship[b];
+        q = adtm->blk[b];
+        last = min(q + PAR_BLOCK, adtm->qoff[id + 1]);
+        s = 0;
+        for ( ; q < last; q++) {
+            /* s[id] >= m implica que s[id] não poderá ser um novo
+               limitante inferior */
+            if (atomic_load_explicit(&adtm->s[id], memory_order_relaxed) + s
+                >= atomic_load_explicit(&adtm->m, memory_order_relaxed)) {
+                METRIC_ADD(pruned, 1);
+                break;
+            }
+            d = get_dist(adtm->fleet, adtm->p1[adtm->qidx[q]],
+                         adtm->p2[adtm->qidx[q]]);
+            if (d == -1 || d == FLEET_INF) {
+                /* a nave é de tipo desconhecido */
+                atomic_store(&adtm->error, true);
+                atomic_store(&adtm->m, 0);
+                METRIC_FLUSH(adtm->fleet);
+                return NULL;
+            }
+            s += d;
+        }
+        /* mesmo interrompido, o bloco soma o que calculou, de modo que
+           s[id] >= m continua valendo */
+        s += atomic_fetch_add(&adtm->s[id], s);
+        if (atomic_fetch_sub(&adtm->r[id], 1) == 1) atomic_min(&adtm->m, s);
+        /* m <= 1 é a menor cota inferior possível */
+        if (atomic_load_explicit(&adtm->m, memory_order_relaxed) <= 1) {
+            METRIC_ADD(early, 1);
+            break;
+        }
+    }
+    METRIC_FLUSH(adtm->fleet);
+    return NULL;
+}
+
+inline void atomic_min(_Atomic int64_t *x, int64_t y)
+{   /* x = min(x, y) */
+
+    int64_t cur = atomic_load_explicit(x, memory_order_relaxed);
+
+    while (y < cur && !atomic_compare_exchange_weak(x, &cur, y)) ;
+}
+
+void run_tasks(void *task, size_t size, int32_t ntask, void *(*fn)(void *),
+               TaskThread *thread)
+{   /* executa fn para cada uma das ntask tarefas do vetor task, cujos
+       elementos têm size bytes, em uma thread própria; a tarefa 0, assim
+       como toda tarefa cuja thread não pôde ser criada, é executada pela
+       thread corrente. Se thread é NULL, o vetor de ntask threads é alocado
+       aqui */
+
+    TaskThread *buf = NULL;
+    char *t = task;
+
+    if (thread == NULL) thread = buf = malloc(ntask * sizeof(TaskThread));
+    for (int32_t i = 1; thread != NULL && i < ntask; i++) {
+        thread[i].created = pthread_create(&thread[i].id, NULL, fn,
+                                           t + i * size) == 0;
+    }
+    fn(t);
+    for (int32_t i = 1; i < ntask; i++) {
+        if (thread != NULL && thread[i].created) {
+            pthread_join(thread[i].id, NULL);
+        } else {
+            fn(t + i * size);
+        }
+    }
+    free(buf);
+}
+
+void *scan_union(void *arg)
+{   /* une os extremos dos teleportes da fatia id do vetor de teleportes */
+
+    ScanTask *task = arg;
+    Scan *scan = task->scan;
+    Fleet *fleet = scan->fleet;
+    int64_t first = (int64_t)fleet->ntp * task->id / scan->nthread;
+    int64_t last = (int64_t)fleet->ntp * (task->id + 1) / scan->nthread;
+    int32_t u, v, tmp;
+
+    for (int64_t i = first; i < last; i++) {
+        if ((u = fleet->tp[i].p1) == NIL) continue;
+        v = fleet->tp[i].p2;
+        for (;;) {
+            u = uf_find(scan->parent, u);
+            v = uf_find(scan->parent, v);
+            if (u == v) break;
+            /* a raiz de maior índice passa a apontar para a de menor
+               índice, desde que ainda seja uma raiz */
+            if (u < v) { tmp = u; u = v; v = tmp; }
+            tmp = u;
+            if (atomic_compare_exchange_weak(&scan->parent[u], &tmp, v)) break;
+        }
+    }
+    return NULL;
+}
+
+void *scan_find(void *arg)
+{   /* associa cada posto da fatia id do vetor de postos à raiz do seu
+       conjunto e prepara o posto para a busca em profundidade */
+
+    ScanTask *task = arg;
+    Scan *scan = task->scan;
+    Fleet *fleet = scan->fleet;
+    int64_t first = (int64_t)fleet->npost * task->id / scan->nthread;
+    int64_t last = (int64_t)fleet->npost * (task->id + 1) / scan->nthread;
+
+    for (int64_t i = first; i < last; i++) {
+        atomic_store_explicit(&scan->parent[i], uf_find(scan->parent, i),
+                              memory_order_relaxed);
+        fleet->post.ship[i] = NIL;
+        fleet->post.pi[i] = NIL;
+    }
+    return NULL;
+}
+
+void *scan_visit(void *arg)
+{   /* explora as naves ainda não exploradas, uma de cada vez */
+
+    ScanTask *task = arg;
+    Scan *scan = task->scan;
+    int32_t nship = scan->fleet->nship;
+    int32_t *stack;
+    int32_t id;
+
+    if ((stack = malloc(scan->mpost * sizeof(int32_t))) == NULL) {
+        atomic_store(&scan->nomem, true);
+        return NULL;
+    }
+    while ((id = atomic_fetch_add(&scan->next, 1)) < nship) {
+        ship_visit(scan->fleet, id, stack);
+    }
+    free(stack);
+    METRIC_FLUSH(scan->fleet);
+    return NULL;
+}
+
+void *scan_group(void *arg)
+{   /* monta a fatia id do bitset de grupos */
+
+    ScanTask *task = arg;
+    Scan *scan = task->scan;
+    size_t nword = GROUP_NWORD(scan->fleet->npost);
+
+    set_group(scan->fleet, nword * task->id / scan->nthread,
+              nword * (task->id + 1) / scan->nthread);
+    return NULL;
+}
+
+int32_t xs_union(XScan *xs)
+{   /* lê os teleportes, copiando-os para xs->raw em blocos de XS_CHUNK, conta
+       o grau de cada posto e une os postos de cada teleporte; como a raiz de
+       cada conjunto é o seu posto de menor índice, as naves recebem os mesmos
+       ids que em fleet_scan() */
+
+    Fleet *fleet = xs->fleet;
+    int32_t npost = fleet->npost;
+    int32_t *buf, *parent, *deg;
+    int32_t n, u, v;
+
+    xs->sid = parent = malloc(npost * sizeof(int32_t));
+    xs->deg = deg = calloc(npost, sizeof(int32_t));
+    buf = malloc(2 * XS_CHUNK * sizeof(int32_t));
+    if (parent == NULL || deg == NULL || buf == NULL) { free(buf); return -3; }
+    if ((xs->raw = tmpfile()) == NULL) { free(buf); return -5; }
+
+    for (int32_t i = 0; i < npost; i++) parent[i] = i;
+    for (int32_t done = 0; done < fleet->ntp; done += n) {
+        n = min(fleet->ntp - done, XS_CHUNK);
+        if (xs->read(xs->arg, buf, buf + XS_CHUNK, n) != n) {
+            free(buf);
+            return -4;
+        }
+        for (int32_t k = 0; k < n; k++) {
+            u = buf[k]; v = buf[XS_CHUNK + k];
+            if (u < 0 || u >= npost || v < 0 || v >= npost) {
+                free(buf);
+                return -4;
+            }
+            deg[u]++; deg[v]++;
+            u = uf_root(parent, u);
+            v = uf_root(parent, v);
+            if (u < v) parent[v] = u;
+            else parent[u] = v;
+        }
+        if (fwrite(buf, sizeof(int32_t), n, xs->raw) != (size_t)n
+            || fwrite(buf + XS_CHUNK, sizeof(int32_t), n, xs->raw)
+               != (size_t)n) {
+            free(buf);
+            return -5;
+        }
+    }
+    free(buf);
+
+    /* parent[p] <= p; logo, ao chegar a p, parent[parent[p]] já contém o id
+       da nave de p */
+    for (int32_t i = 0; i < npost; i++) {
+        if (parent[i] == i) {
+            if (add_ship(fleet, i) == NIL) return -3;
+            parent[i] = fleet->nship - 1;
+        } else {
+            parent[i] = parent[parent[i]];
+        }
+    }
+    return 0;
+}
+
+int32_t xs_split(XScan *xs)
+{   /* agrupa naves consecutivas em grupos de até xs->cap teleportes e copia
+       os teleportes de xs->raw para xs->part, com os de cada grupo em uma
+       região contígua e na ordem da entrada */
+
+    Fleet *fleet = xs->fleet;
+    int32_t nship = fleet->nship;
+    int32_t *sid = xs->sid, *bucket;
+    int64_t *cnt, *boff, *wpos, cur = 0;
+    int32_t *buf, *wbuf, *wcnt, *w;
+    int32_t nbucket = 0, nbuf, n, b;
+    int32_t ret = 0;
+
+    /* teleportes por nave: a soma dos graus é o dobro */
+    if ((cnt = calloc(nship, sizeof(int64_t))) == NULL) return -3;
+    for (int32_t i = 0; i < fleet->npost; i++) cnt[sid[i]] += xs->deg[i];
+
+    if ((xs->bucket = bucket = malloc(nship * sizeof(int32_t))) == NULL) {
+        free(cnt);
+        return -3;
+    }
+    for (int32_t k = 0; k < nship; k++) {
+        cnt[k] /= 2;
+        if (cur > 0 && cur + cnt[k] > xs->cap) { nbucket++; cur = 0; }
+        bucket[k] = nbucket;
+        cur += cnt[k];
+    }
+    xs->nbucket = ++nbucket;
+    if ((xs->boff = boff = calloc(nbucket + 1, sizeof(int64_t))) == NULL) {
+        free(cnt);
+        return -3;
+    }
+    for (int32_t k = 0; k < nship; k++) boff[bucket[k] + 1] += cnt[k];
+    for (b = 0; b < nbucket; b++) boff[b + 1] += boff[b];
+    free(cnt);
+
+    /* os buffers de gravação dos grupos dividem a memória de um grupo */
+    nbuf = min(max(2 * xs->cap / nbucket, (int64_t)XS_MINBUF),
+               (int64_t)XS_MAXBUF);
+    buf = malloc(2 * XS_CHUNK * sizeof(int32_t));
+    wbuf = malloc(2 * (size_t)nbuf * nbucket * sizeof(int32_t));
+    wcnt = calloc(nbucket, sizeof(int32_t));
+    wpos = malloc(nbucket * sizeof(int64_t));
+    if (buf == NULL || wbuf == NULL || wcnt == NULL || wpos == NULL) {
+        free(buf); free(wbuf); free(wcnt); free(wpos);
+        return -3;
+    }
+    memcpy(wpos, boff, nbucket * sizeof(int64_t));
+    if ((xs->part = tmpfile()) == NULL) ret = -5;
+    else rewind(xs->raw);
+
+    for (int32_t done = 0; ret == 0 && done < fleet->ntp; done += n) {
+        n = min(fleet->ntp - done, XS_CHUNK);
+        if (fread(buf, sizeof(int32_t), n, xs->raw) != (size_t)n
+            || fread(buf + XS_CHUNK, sizeof(int32_t), n, xs->raw)
+               != (size_t)n) {
+            ret = -5;
+            break;
+        }
+        for (int32_t k = 0; k < n && ret == 0; k++) {
+            b = bucket[sid[buf[k]]];
+            w = wbuf + 2 * (size_t)b * nbuf;
+            w[2 * wcnt[b]] = buf[k];
+            w[2 * wcnt[b] + 1] = buf[XS_CHUNK + k];
+            if (++wcnt[b] == nbuf && !xs_flush(xs->part, w, &wcnt[b], &wpos[b]))
+                ret = -5;
+        }
+    }
+    /* descarrega os buffers que não se encheram */
+    for (b = 0; b < nbucket && ret == 0; b++) {
+        if (!xs_flush(xs->part, wbuf + 2 * (size_t)b * nbuf, &wcnt[b],
+                      &wpos[b])) ret = -5;
+    }
+    free(buf); free(wbuf); free(wcnt); free(wpos);
+    fclose(xs->raw);
+    xs->raw = NULL;
+
+    return ret;
+}
+
+bool xs_flush(FILE *part, const int32_t *w, int32_t *n, int64_t *pos)
+{   /* grava os n teleportes do buffer w na posição pos, em teleportes, do
+       arquivo part, e avança pos */
+
+    if (*n == 0) return true;
+
+    if (fseeko(part, *pos * 2 * sizeof(int32_t), SEEK_SET) != 0
+        || fwrite(w, 2 * sizeof(int32_t), *n, part) != (size_t)*n)
+        return false;
+    *pos += *n;
+    *n = 0;
+    return true;
+}
+
+int32_t xs_visit(XScan *xs)
+{   /* carrega os teleportes de cada grupo, monta com eles as listas de
+       adjacências dos postos do grupo e explora as naves do grupo, montando
+       o atributo jump das fragatas enquanto as listas existem */
+
+    Fleet *fleet = xs->fleet;
+    int32_t npost = fleet->npost, nbucket = xs->nbucket;
+    int32_t *deg = xs->deg;
+    int32_t *ord, *poff;    /* postos do grupo b: ord[poff[b]..poff[b+1]-1] */
+    int32_t *adj_idx, *adj_end, *adj, *tp, *stack;
+    int64_t ne, mtp = 0;
+    int32_t k = 0, u, pos, ret = 0;
+
+    /* ordenação por contagem dos postos por grupo, em ordem crescente */
+    ord = malloc(npost * sizeof(int32_t));
+    poff = calloc(nbucket + 1, sizeof(int32_t));
+    if (ord == NULL || poff == NULL) { free(ord); free(poff); return -3; }
+    for (int32_t i = 0; i < npost; i++) poff[xs->bucket[xs->sid[i]] + 1]++;
+    for (int32_t b = 0; b < nbucket; b++) poff[b + 1] += poff[b];
+    for (int32_t i = 0; i < npost; i++) {
+        ord[poff[xs->bucket[xs->sid[i]]]++] = i;
+    }
+    for (int32_t b = nbucket; b > 0; b--) poff[b] = poff[b - 1];
+    poff[0] = 0;
+    free(xs->sid);
+    xs->sid = NULL;
+
+    for (int32_t b = 0; b < nbucket; b++) {
+        mtp = max(mtp, xs->boff[b + 1] - xs->boff[b]);
+    }
+    adj_idx = malloc(npost * sizeof(int32_t));
+    adj_end = malloc(npost * sizeof(int32_t));
+    adj = malloc(2 * mtp * sizeof(int32_t));
+    tp = malloc(2 * mtp * sizeof(int32_t));
+    stack = malloc(npost * sizeof(int32_t));
+    if (adj_idx == NULL || adj_end == NULL || adj == NULL || tp == NULL
+        || stack == NULL) {
+        free(ord); free(poff); free(adj_idx); free(adj_end); free(adj);
+        free(tp); free(stack);
+        return -3;
+    }
+    for (int32_t i = 0; i < npost; i++) fleet->post.ship[i] = NIL;
+    fleet->adj_idx = adj_idx;
+    fleet->adj_end = adj_end;
+    fleet->adj = adj;
+
+    for (int32_t b = 0; b < nbucket && ret == 0; b++) {
+        ne = xs->boff[b + 1] - xs->boff[b];
+        if (fseeko(xs->part, xs->boff[b] * 2 * sizeof(int32_t), SEEK_SET)
+            != 0 || fread(tp, 2 * sizeof(int32_t), ne, xs->part)
+                    != (size_t)ne) {
+            ret = -5;
+            break;
+        }
+        /* adj_idx[u] e adj_end[u] recebem o fim da lista de u; os postos
+           fora do grupo não são consultados */
+        pos = 0;
+        for (int32_t i = poff[b]; i < poff[b + 1]; i++) {
+            u = ord[i];
+            pos += deg[u];
+            adj_idx[u] = pos;
+            adj_end[u] = pos;
+        }
+        /* como em pack_adj(), cada lista fica em ordem decrescente de
+           índice do teleporte */
+        for (int64_t i = 0; i < ne; i++) {
+            adj[--adj_idx[tp[2 * i]]] = tp[2 * i + 1];
+            adj[--adj_idx[tp[2 * i + 1]]] = tp[2 * i];
+        }
+        for ( ; k < fleet->nship && xs->bucket[k] == b; k++) {
+            ship_visit(fleet, k, stack);
+            if (fleet->ship[k].type == FLEET_FRIGATE
+                && set_jump(fleet, &fleet->ship[k]) < 0) {
+                ret = -3;
+                break;
+            }
+        }
+    }
+    fleet->adj_idx = NULL;
+    fleet->adj_end = NULL;
+    fleet->adj = NULL;
+    free(ord); free(poff); free(adj_idx); free(adj_end); free(adj); free(tp);
+    free(stack);
+
+    return ret;
+}
+
+void xs_free(XScan *xs)
+{
+    free(xs->sid); free(xs->deg); free(xs->bucket); free(xs->boff);
+    if (xs->raw != NULL) fclose(xs->raw);
+    if (xs->part != NULL) fclose(xs->part);
+}
+
+void set_group(Fleet *fleet, size_t first, size_t last)
+{   /* monta as palavras first, ..., last - 1 do bitset de grupos: como o
+       grupo da raiz é 0 e o de cada outro posto é o oposto do grupo do seu
+       pai, o grupo é a paridade da profundidade */
+
+    int32_t *depth = fleet->post.depth;
+    size_t npost = fleet->npost;
+    uint64_t word;
+
+    for (size_t k = first; k < last; k++) {
+        word = 0;
+        for (size_t p = 64 * k; p < 64 * k + 64 && p < npost; p++) {
+            word |= (uint64_t)(depth[p] & 1) << (p & 63);
+        }
+        fleet->post.group[k] = word;
+    }
+}
+
+inline int32_t uf_find(atomic_int *parent, int32_t u)
+{   /* retorna a raiz do conjunto de u, encurtando o caminho percorrido pela
+       metade; como cada posto só aponta para postos de menor índice, as
+       escritas concorrentes não criam ciclos */
+
+    int32_t p, gp;
+
+    while ((p = atomic_load_explicit(&parent[u], memory_order_relaxed)) != u) {
+        gp = atomic_load_explicit(&parent[p], memory_order_relaxed);
+        if (gp != p) {
+            atomic_compare_exchange_weak_explicit(&parent[u], &p, gp,
+                memory_order_relaxed, memory_order_relaxed);
+        }
+        u = gp;
+    }
+    return u;
+}
+
+size_t img_layout(int32_t nship, int32_t npost, int32_t ntp, bool label,
+                  size_t *off)
+{   /* calcula o deslocamento de cada seção da imagem em off e retorna o
+       tamanho total da imagem */
+
+    size_t len[IMG_NSEC];
+
+    len[IMG_SHIP] = (size_t)nship * 4 * sizeof(int32_t);
+    len[IMG_POSTSHIP] = (size_t)npost * sizeof(int32_t);
+    len[IMG_PI] = (size_t)npost * sizeof(int32_t);
+    len[IMG_DEPTH] = (size_t)npost * sizeof(int32_t);
+    len[IMG_JUMP] = (size_t)npost * sizeof(int32_t);
+    len[IMG_POS] = (size_t)npost * sizeof(int32_t);
+    len[IMG_GROUP] = GROUP_NWORD(npost) * sizeof(uint64_t);
+    len[IMG_TP] = (size_t)ntp * sizeof(Teleport);
+    len[IMG_ADJIDX] = ((size_t)npost + 1) * sizeof(int32_t);
+    len[IMG_ADJ] = (size_t)ntp * 2 * sizeof(int32_t);
+    len[IMG_LABEL] = label ? (size_t)npost * sizeof(int32_t) : 0;
+
+    off[0] = sizeof(ImgHeader);
+    for (int32_t i = 0; i < IMG_NSEC; i++) {
+        off[i + 1] = (off[i] + len[i] + 7) & ~(size_t)7;
+    }
+    return off[IMG_NSEC];
+}
+
+bool img_write(FILE *file, const void *data, size_t len)
+{   /* grava len bytes de data, se data não é NULL, e completa a seção com
+       zeros até o próximo múltiplo de 8 bytes */
+
+    static const char zero[8];
+
+    if (data != NULL && len > 0 && fwrite(data, len, 1, file) != 1)
+        return false;
+
+    if (len % 8 != 0 && fwrite(zero, 8 - len % 8, 1, file) != 1)
+        return false;
+
+    return true;
+}
+
+bool img_adj(FILE *file, const Fleet *fleet)
+{   /* grava as seções adj_idx e adj com as listas de adjacências
+       compactadas, como após a exploração, já que fleet_link() e
+       fleet_unlink() podem ter deixado espaço livre entre elas; adj é
+       completado com zeros até 2 * ntp destinos */
+
+    const int32_t zero = 0;
+    int32_t pos = 0, n;
+    bool ok = true;
+
+    for (int32_t u = 0; u <= fleet->npost && ok; u++) {
+        ok = fwrite(&pos, sizeof(int32_t), 1, file) == 1;
+        if (u < fleet->npost) pos += fleet->adj_end[u] - fleet->adj_idx[u];
+    }
+    ok = ok && img_write(file, NULL, (fleet->npost + 1) * sizeof(int32_t));
+
+    for (int32_t u = 0; u < fleet->npost && ok; u++) {
+        n = fleet->adj_end[u] - fleet->adj_idx[u];
+        ok = n == 0 || fwrite(&fleet->adj[fleet->adj_idx[u]],
+                              sizeof(int32_t), n, file) == (size_t)n;
+    }
+    for ( ; pos < 2 * fleet->ntp && ok; pos++) {
+        ok = fwrite(&zero, sizeof(int32_t), 1, file) == 1;
+    }
+
+    return ok && img_write(file, NULL, 2 * fleet->ntp * sizeof(int32_t));
+}
+
+int32_t img_load(Fleet *fleet, char *img, size_t size, const size_t *off)
+{   /* aponta os vetores da frota para as seções da imagem img, de size
+       bytes, que passa a pertencer à frota mesmo em caso de falha, e valida
+       os valores que servem de índice */
+
+    const ImgHeader *hdr = (const ImgHeader *)img;
+    Posts *post = &fleet->post;
+    int32_t npost = hdr->npost;
+    int32_t nship = hdr->nship;
+    int32_t ret;
+    Ship *ship;
+
+    fleet->nship = nship;
+    fleet->mship = nship;
+    fleet->ship = (Ship *)(img + off[IMG_SHIP]);
+    fleet->npost = npost;
+    fleet->mpost = npost;
+    post->ship = (int32_t *)(img + off[IMG_POSTSHIP]);
+    post->pi = (int32_t *)(img + off[IMG_PI]);
+    post->depth = (int32_t *)(img + off[IMG_DEPTH]);
+    post->jump = (int32_t *)(img + off[IMG_JUMP]);
+    post->pos = (int32_t *)(img + off[IMG_POS]);
+    post->group = (uint64_t *)(img + off[IMG_GROUP]);
+    fleet->ntp = hdr->ntp;
+    fleet->mtp = hdr->ntp;
+    fleet->tp = (Teleport *)(img + off[IMG_TP]);
+    fleet->madj = 2 * hdr->ntp;
+    fleet->adj_idx = (int32_t *)(img + off[IMG_ADJIDX]);
+    fleet->adj_end = malloc(npost * sizeof(int32_t));
+    fleet->adj_lim = NULL;
+    fleet->adj = (int32_t *)(img + off[IMG_ADJ]);
+    fleet->lca = FLEET_LCA_SQRT;
+    fleet->lca_n = 0;
+    fleet->lca_nlev = 0;
+    fleet->lca_pre = NULL;
+    fleet->lca_tbl = NULL;
+    fleet->label = hdr->label ? (int32_t *)(img + off[IMG_LABEL]) : NULL;
+    fleet->origin = NULL;
+    fleet->img = img;
+    fleet->img_size = size;
+    memset(&fleet->metrics, 0, sizeof(FleetMetrics));
+    if (fleet->adj_end == NULL) return -4;
+
+    if (fleet->adj_idx[0] != 0 || fleet->adj_idx[npost] > 2 * fleet->ntp)
+        return -3;
+    for (int32_t i = 0; i < npost; i++) {
+        if (fleet->adj_idx[i] > fleet->adj_idx[i + 1]) return -3;
+    }
+    for (int32_t i = 0; i < fleet->adj_idx[npost]; i++) {
+        if (fleet->adj[i] < 0 || fleet->adj[i] >= npost) return -3;
+    }
+    for (int32_t i = 0; i < npost; i++) {
+        fleet->adj_end[i] = fleet->adj_idx[i + 1];
+    }
+
+    for (int32_t id = 0; id < nship; id++) {
+        ship = &fleet->ship[id];
+        if (ship->type < 0 || ship->type >= FLEET_NTYPE || ship->root < 0
+            || ship->root >= npost || ship->height < 1) return -3;
+    }
+    for (int32_t i = 0; i < npost; i++) {
+        if (post->ship[i] < 0 || post->ship[i] >= nship
+            || post->pi[i] < NIL || post->pi[i] >= npost
+            || post->depth[i] < 0 || post->depth[i] >= npost
+            || post->jump[i] < ND || post->jump[i] >= npost
+            || post->pos[i] < NIL || post->pos[i] >= npost) return -3;
+    }
+    if ((ret = img_check(fleet)) < 0) return ret;
+    if (fleet->label == NULL) return 0;
+
+    /* a numeração deve ser uma permutação dos postos */
+    fleet->origin = malloc(npost * sizeof(int32_t));
+    if (fleet->origin == NULL) return -4;
+    for (int32_t i = 0; i < npost; i++) fleet->origin[i] = NIL;
+    for (int32_t i = 0; i < npost; i++) {
+        if (fleet->label[i] < 0 || fleet->label[i] >= npost
+            || fleet->origin[fleet->label[i]] != NIL) return -3;
+        fleet->origin[fleet->label[i]] = i;
+    }
+
+    return 0;
+}
+
+int32_t img_check(Fleet *fleet)
+{   /* verifica se as árvores das naves são consistentes, de modo que as
+       subidas pelos atributos pi e jump terminam sempre na raiz: cada posto
+       que não é raiz tem o pai na mesma nave, um nível acima, está na lista
+       de adjacências do pai e tem o atributo jump que set_jump() lhe daria;
+       as contagens e alturas das naves conferem com os postos. Retorna -3
+       se há inconsistência ou -4 se não foi possível alocar memória */
+
+    Posts *post = &fleet->post;
+    int32_t npost = fleet->npost, nship = fleet->nship;
+    int32_t *cnt;       /* número de postos e altura de cada nave, em pares */
+    bool *seen;         /* postos alcançados a partir do pai */
+    Ship *ship;
+    int32_t u, v, jump, ret = 0;
+
+    cnt = calloc(2 * (size_t)nship, sizeof(int32_t));
+    seen = calloc(npost, sizeof(bool));
+    if (cnt == NULL || seen == NULL) { free(cnt); free(seen); return -4; }
+
+    for (u = 0; u < npost; u++) {
+        for (int32_t i = fleet->adj_idx[u]; i < fleet->adj_end[u]; i++) {
+            v = fleet->adj[i];
+            if (post->pi[v] == u) seen[v] = true;
+        }
+    }
+    for (v = 0; v < npost && ret == 0; v++) {
+        ship = &fleet->ship[post->ship[v]];
+        u = post->pi[v];
+        if (v == ship->root) {
+            /* jump é NIL, ou ND se ainda não foi montado para a nave */
+            if (u != NIL || post->depth[v] != 0
+                || (post->jump[v] != NIL && post->jump[v] != ND)) ret = -3;
+        } else if (u == NIL || !seen[v] || post->ship[u] != post->ship[v]
+                   || post->depth[u] != post->depth[v] - 1) {
+            ret = -3;
+        } else {
+            if (post->jump[ship->root] == ND) jump = ND;
+            else if (post->depth[v] % (int32_t)sqrt(ship->height) == 0)
+                jump = u;
+            else jump = post->jump[u];
+            if (post->jump[v] != jump) ret = -3;
+        }
+        cnt[2 * post->ship[v]]++;
+        cnt[2 * post->ship[v] + 1] = max(cnt[2 * post->ship[v] + 1],
+                                         post->depth[v] + 1);
+    }
+    for (int32_t id = 0; id < nship && ret == 0; id++) {
+        ship = &fleet->ship[id];
+        if (post->ship[ship->root] != id || ship->npost != cnt[2 * id]
+            || ship->height != cnt[2 * id + 1]) ret = -3;
+    }
+    free(cnt); free(seen);
+
+    return ret;
+}
+
+inline bool img_owns(const Fleet *fleet, const void *ptr)
+{   /* indica se ptr aponta para a imagem mapeada da frota */
+
+    uintptr_t p = (uintptr_t)ptr, base = (uintptr_t)fleet->img;
+
+    return fleet->img != NULL && p >= base && p < base + fleet->img_size;
+}
+
+void img_free(Fleet *fleet, void *ptr)
+{   /* libera ptr, a menos que aponte para a imagem mapeada da frota */
+
+    if (!img_owns(fleet, ptr)) free(ptr);
+}
+
+void *img_realloc(Fleet *fleet, void *ptr, size_t len, size_t size)
+{   /* equivale a realloc(ptr, size), mas, se ptr aponta para a imagem
+       mapeada da frota, os len primeiros bytes são copiados para um novo
+       bloco e a imagem não é alterada */
+
+    void *p;
+
+    if (!img_owns(fleet, ptr)) return realloc(ptr, size);
+
+    if ((p = malloc(size)) != NULL) memcpy(p, ptr, min(len, size));
+
+    return p;
+}
+
+void img_unmap(Fleet *fleet)
+{   /* desfaz o mapeamento da imagem da frota, se houver; os vetores que
+       ainda apontam para ela passam a ser NULL */
+
+    Posts *post = &fleet->post;
+
+    if (fleet->img == NULL) return;
+
+    if (img_owns(fleet, post->ship)) post->ship = NULL;
+    if (img_owns(fleet, post->pi)) post->pi = NULL;
+    if (img_owns(fleet, post->depth)) post->depth = NULL;
+    if (img_owns(fleet, post->jump)) post->jump = NULL;
+    if (img_owns(fleet, post->pos)) post->pos = NULL;
+    if (img_owns(fleet, post->group)) post->group = NULL;
+    if (img_owns(fleet, fleet->tp)) fleet->tp = NULL;
+    if (img_owns(fleet, fleet->adj_idx)) fleet->adj_idx = NULL;
+    if (img_owns(fleet, fleet->adj)) fleet->adj = NULL;
+    munmap(fleet->img, fleet->img_size);
+    fleet->img = NULL;
+    fleet->img_size = 0;
+}
+
+bool ship_alloc(Fleet *fleet, int32_t mship)
+{   /* redimensiona o vetor de naves para comportar mship naves */
+
+    Ship *ship;
+
+    ship = img_realloc(fleet, fleet->ship, fleet->mship * sizeof(Ship),
+                       mship * sizeof(Ship));
+    if (ship == NULL) return false;
+
+    fleet->ship = ship;
+    fleet->mship = mship;
+
+    return true;
+}
+
+inline int32_t add_ship(Fleet *fleet, int32_t root)
+{   /* retorna o id da nova nave ou NIL se não foi possível alocar memória; o
+       vetor de naves dobra de tamanho quando cheio, até o limite de npost */
+
+    Ship *ship;
+
+    if (fleet->nship == fleet->mship
+        && !ship_alloc(fleet, min(max(2 * fleet->mship, 64), fleet->npost)))
+        return NIL;
+
+    ship = &fleet->ship[fleet->nship];
+    ship->npost = 0;
+    ship->root = root;
+    ship->height = 1;
+
+    return fleet->nship++;
+}
+
+void ship_visit(Fleet *fleet, int32_t id, int32_t *stack)
+{   /* baseado no algoritmo de busca em profundidade com pilha; stack deve
+       comportar todos os postos da nave */
+
+    Ship *ship = &fleet->ship[id];
+    Posts *post = &fleet->post;
+    int32_t idx = 0;                /* índice da pilha */
+    int32_t u, v;
+    int32_t mdeg = 0;   /* grau máximo */
+    int32_t nback = 0;  /* número de arestas fora da árvore */
+    int32_t first, last;
+
+    add_post(fleet, id, ship->root, NIL);
+    stack[idx++] = ship->root;
+
+    while (idx > 0) {
+        /* retira um posto da fila */
+        u = stack[--idx];
+
+        /* percorre a lista de adjacências do posto de combate u */
+        first = fleet->adj_idx[u];
+        last = fleet->adj_end[u];
+        METRIC_ADD(edges, last - first);
+        for (int32_t i = first; i < last; i++) {
+            v = fleet->adj[i];
+            if (post->ship[v] == NIL) {
+                add_post(fleet, id, v, u);
+                stack[idx++] = v;
+            } else if (v != post->pi[u]
+                       && (post->depth[v] < post->depth[u]
+                           || (post->depth[v] == post->depth[u] && v < u))) {
+                /* uv não é aresta da árvore; como v já foi descoberto, a
+                   aresta é contada uma única vez, a partir do posto mais
+                   profundo ou, se ambos têm a mesma profundidade, do de maior
+                   id */
+                nback++;
+            }
+        }
+        if (last - first > mdeg) mdeg = last - first;
+    }
+    /* classifica a nave encontrada */
+    ship_class(ship, mdeg, nback);
+
+    /* um reconhecimento é um caminho, e um transportador com grau máximo 2 é
+       um ciclo; em ambos, a árvore da nave é um caminho */
+    if (ship->type == FLEET_SCOUT
+        || (ship->type == FLEET_TRANSPORT && mdeg == 2)) set_pos(fleet, ship);
+}
+
+inline void add_post(Fleet *fleet, int32_t id, int32_t p, int32_t pi)
+{   /* o grupo do posto é definido depois, por set_group() */
+
+    Ship *ship = &fleet->ship[id];
+    Posts *post = &fleet->post;
+
+    /* adiciona o posto na nave */
+    post->ship[p] = id;
+    ship->npost++;
+
+    /* monta a floresta de BP */
+    post->pi[p] = pi;
+    if (pi == NIL) post->depth[p] = 0;
+    else post->depth[p] = 1 + post->depth[pi];
+    post->jump[p] = ND;
+    post->pos[p] = NIL;
+
+    /* atualiza a altura da árvore da nave, se necessário */
+    if (post->depth[p] + 1 > ship->height) ship->height = post->depth[p] + 1;
+}
+
+bool post_alloc(Posts *post, int32_t npost)
+{   /* aloca os vetores de atributos de npost postos de combate */
+
+    post->ship = malloc(npost * sizeof(int32_t));
+    post->pi = malloc(npost * sizeof(int32_t));
+    post->depth = malloc(npost * sizeof(int32_t));
+    post->jump = malloc(npost * sizeof(int32_t));
+    post->pos = malloc(npost * sizeof(int32_t));
+    post->group = malloc(GROUP_NWORD(npost) * sizeof(uint64_t));
+    if (post->ship == NULL || post->pi == NULL || post->depth == NULL
+        || post->jump == NULL || post->pos == NULL || post->group == NULL) {
+        post_free(post);
+        return false;
+    }
+    return true;
+}
+
+void post_free(Posts *post)
+{   /* libera os vetores de atributos dos postos de combate */
+
+    free(post->ship); free(post->pi); free(post->depth);
+    free(post->jump); free(post->pos); free(post->group);
+    post->ship = NULL;
+    post->pi = NULL;
+    post->depth = NULL;
+    post->jump = NULL;
+    post->pos = NULL;
+    post->group = NULL;
+}
+
+void scan_free(Fleet *fleet)
+{   /* libera o que foi montado a partir da exploração da frota: as naves, o
+       índice de ancestral comum mais baixo e a renumeração dos postos */
+
+    img_free(fleet, fleet->ship);
+    fleet->ship = NULL;
+    fleet->nship = 0;
+    fleet->mship = 0;
+    free(fleet->lca_pre); free(fleet->lca_tbl);
+    fleet->lca_pre = NULL;
+    fleet->lca_tbl = NULL;
+    fleet->lca = FLEET_LCA_SQRT;
+    fleet->lca_n = 0;
+    fleet->lca_nlev = 0;
+    img_free(fleet, fleet->label); free(fleet->origin);
+    fleet->label = NULL;
+    fleet->origin = NULL;
+}
+
+bool adj_reserve(Fleet *fleet, int32_t u, int32_t n)
+{   /* garante espaço livre para n destinos após o fim da lista de
+       adjacências de u; se não há, a lista é copiada para o fim da parte
+       usada de adj com o dobro do espaço necessário, de modo que o custo das
+       cópias é O(1) amortizado por inserção. Retorna false se não foi
+       possível alocar memória, caso em que a lista continua válida */
+
+    int32_t *adj_idx = fleet->adj_idx, *lim = fleet->adj_lim;
+    int32_t first = adj_idx[u], len = fleet->adj_end[u] - first;
+    int64_t tail = adj_idx[fleet->npost], cap, madj;
+    int32_t *adj;
+
+    if (fleet->adj_end[u] + n <= (lim != NULL ? lim[u] : adj_idx[u + 1]))
+        return true;
+
+    if (lim == NULL) {
+        lim = malloc(fleet->mpost * sizeof(int32_t));
+        if (lim == NULL) return false;
+        for (int32_t i = 0; i < fleet->npost; i++) lim[i] = adj_idx[i + 1];
+        fleet->adj_lim = lim;
+    }
+    cap = 2 * ((int64_t)len + n);
+    if (tail + cap > fleet->madj) {
+        madj = min(max(2 * (int64_t)fleet->madj, tail + cap), INT32_MAX);
+        if (tail + cap > madj) return false;
+        adj = img_realloc(fleet, fleet->adj, fleet->madj * sizeof(int32_t),
+                          madj * sizeof(int32_t));
+        if (adj == NULL) return false;
+        fleet->adj = adj;
+        fleet->madj = (int32_t)madj;
+    }
+    memcpy(&fleet->adj[tail], &fleet->adj[first], len * sizeof(int32_t));
+    adj_idx[u] = (int32_t)tail;
+    fleet->adj_end[u] = (int32_t)(tail + len);
+    lim[u] = (int32_t)(tail + cap);
+    adj_idx[fleet->npost] = (int32_t)(tail + cap);
+
+    return true;
+}
+
+bool tp_grow(Fleet *fleet, int32_t idx)
+{   /* estende o vetor de teleportes até a posição idx, com as novas posições
+       livres, dobrando a sua capacidade se necessário */
+
+    Teleport *tp;
+    int64_t mtp;
+
+    if (idx >= fleet->mtp) {
+        mtp = max(idx + 1, min(2 * (int64_t)fleet->mtp, FLEET_MAXTP));
+        tp = img_realloc(fleet, fleet->tp, fleet->mtp * sizeof(Teleport),
+                         mtp * sizeof(Teleport));
+        if (tp == NULL) return false;
+        fleet->tp = tp;
+        fleet->mtp = (int32_t)mtp;
+    }
+    for (int32_t i = fleet->ntp; i <= idx; i++) {
+        fleet->tp[i].p1 = NIL;     /* teleporte ainda não adicionado */
+    }
+    fleet->ntp = max(fleet->ntp, idx + 1);
+
+    return true;
+}
+
+void adj_insert(Fleet *fleet, int32_t u, int32_t v)
+{   /* insere v no fim da lista de adjacências de u; assume que
+       adj_reserve() garantiu o espaço */
+
+    fleet->adj[fleet->adj_end[u]++] = v;
+}
+
+void adj_remove(Fleet *fleet, int32_t u, int32_t v)
+{   /* remove uma ocorrência de v da lista de adjacências de u, deslocando os
+       destinos seguintes da lista em uma posição */
+
+    int32_t q = fleet->adj_idx[u];
+
+    while (fleet->adj[q] != v) q++;
+    memmove(&fleet->adj[q], &fleet->adj[q + 1],
+            (fleet->adj_end[u] - q - 1) * sizeof(int32_t));
+    fleet->adj_end[u]--;
+}
+
+int32_t ship_clear(Fleet *fleet, int32_t p, int32_t a, int32_t b,
+                   int32_t *list, int32_t *stack)
+{   /* remove das naves a e b os postos alcançáveis a partir de p por postos
+       dessas naves, gravando-os em list, e retorna quantos são; list e stack
+       devem comportar todos esses postos */
+
+    int32_t *ship = fleet->post.ship;
+    int32_t n = 0, idx = 0, u, v;
+
+    ship[p] = NIL;
+    stack[idx++] = p;
+    while (idx > 0) {
+        u = stack[--idx];
+        list[n++] = u;
+        for (int32_t i = fleet->adj_idx[u]; i < fleet->adj_end[u]; i++) {
+            v = fleet->adj[i];
+            if (ship[v] == a || ship[v] == b) {
+                ship[v] = NIL;
+                stack[idx++] = v;
+            }
+        }
+    }
+    return n;
+}
+
+void ship_redo(Fleet *fleet, int32_t id, int32_t root,
+               const int32_t *list, int32_t n, int32_t *stack)
+{   /* explora novamente, como a nave id, os postos list[0..n-1], removidos
+       das suas naves por ship_clear(); os atributos jump são refeitos sob
+       demanda, e os postos deixam o índice RMQ até o próximo fleet_index() */
+
+    Ship *ship = &fleet->ship[id];
+    Posts *post = &fleet->post;
+    int32_t p;
+
+    ship->npost = 0;
+    ship->root = root;
+    ship->height = 1;
+    ship_visit(fleet, id, stack);
+
+    for (int32_t i = 0; i < n; i++) {
+        p = list[i];
+        if (post->depth[p] & 1) post->group[p >> 6] |= UINT64_C(1) << (p & 63);
+        else post->group[p >> 6] &= ~(UINT64_C(1) << (p & 63));
+        if (fleet->lca_pre != NULL) fleet->lca_pre[p] = NIL;
+    }
+}
+
+void ship_drop(Fleet *fleet, int32_t id, int32_t *stack)
+{   /* remove a nave id, que já não tem postos, movendo a última nave para a
+       sua posição; stack deve comportar todos os postos da última nave */
+
+    int32_t *ship = fleet->post.ship;
+    int32_t last = --fleet->nship;
+    int32_t idx = 0, u, v;
+
+    if (id == last) return;
+
+    fleet->ship[id] = fleet->ship[last];
+    u = fleet->ship[id].root;
+    ship[u] = id;
+    stack[idx++] = u;
+    while (idx > 0) {
+        u = stack[--idx];
+        for (int32_t i = fleet->adj_idx[u]; i < fleet->adj_end[u]; i++) {
+            v = fleet->adj[i];
+            if (ship[v] == last) {
+                ship[v] = id;
+                stack[idx++] = v;
+            }
+        }
+    }
+}
+
+inline void ship_class(Ship *ship, int32_t mdeg, int32_t nback)
+{
+    if (nback == 0) {
+        if (mdeg == 2) ship->type = FLEET_SCOUT;
+        else ship->type = FLEET_FRIGATE;
+    } else if (nback == 1) {
+        ship->type = FLEET_TRANSPORT;
+    } else {
+        ship->type = FLEET_BOMBER;
+    }
+}
+
+void set_pos(Fleet *fleet, Ship *ship)
+{   /* assume que a árvore da nave é um caminho: a raiz tem até dois filhos,
+       e cada um deles inicia uma cadeia; os postos da primeira cadeia ficam
+       antes da raiz, em ordem decrescente de profundidade, e os da segunda,
+       depois dela */
+
+    Posts *post = &fleet->post;
+    int32_t root = ship->root;
+    int32_t c1 = NIL, c2 = NIL;     /* filhos da raiz */
+    int32_t a = 0;                  /* posição da raiz */
+    int32_t v;
+
+    for (int32_t i = fleet->adj_idx[root]; i < fleet->adj_end[root]; i++) {
+        v = fleet->adj[i];
+        if (post->pi[v] != root || v == c1) continue;
+        if (c1 == NIL) c1 = v;
+        else c2 = v;
+    }
+    for (v = c1; v != NIL; v = path_child(fleet, v)) a = post->depth[v];
+
+    post->pos[root] = a;
+    for (v = c1; v != NIL; v = path_child(fleet, v)) {
+        post->pos[v] = a - post->depth[v];
+    }
+    for (v = c2; v != NIL; v = path_child(fleet, v)) {
+        post->pos[v] = a + post->depth[v];
+    }
+}
+
+inline int32_t path_child(Fleet *fleet, int32_t u)
+{   /* retorna o filho de u na árvore da nave, que deve ter no máximo um, ou
+       NIL se u é uma folha */
+
+    int32_t v;
+
+    for (int32_t i = fleet->adj_idx[u]; i < fleet->adj_end[u]; i++) {
+        v = fleet->adj[i];
+        if (fleet->post.pi[v] == u) return v;
+    }
+    return NIL;
+}
+
+void dist_bucket(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                 const int32_t *idx, int32_t n, int32_t type, int64_t *out)
+{   /* responde as consultas idx[0..n-1], n <= DIST_BLOCK, todas a naves do
+       tipo type, que deve ser reconhecimento, transportador com postos
+       numerados ou bombardeiro */
+
+    Posts *post = &fleet->post;
+    int32_t qa[DIST_BLOCK], qb[DIST_BLOCK], qlen[DIST_BLOCK];
+    int32_t i;
+
+    switch (type)
+    {
+        case FLEET_SCOUT:
+            /* um caminho não dá a volta */
+            for (int32_t k = 0; k < n; k++) {
+                i = idx[k];
+                qa[k] = post->pos[p1[i]];
+                qb[k] = post->pos[p2[i]];
+                qlen[k] = INT32_MAX;
+            }
+            break;
+
+        case FLEET_TRANSPORT:
+            for (int32_t k = 0; k < n; k++) {
+                i = idx[k];
+                qa[k] = post->pos[p1[i]];
+                qb[k] = post->pos[p2[i]];
+                qlen[k] = fleet->ship[post->ship[p1[i]]].npost;
+            }
+            break;
+
+        case FLEET_BOMBER:
+            /* um posto do grupo g fica na posição g de um ciclo de 4 posições
+               e outro posto do grupo g, na posição g + 2 */
+            for (int32_t k = 0; k < n; k++) {
+                i = idx[k];
+                qa[k] = GROUP_OF(post->group, p1[i]);
+                qb[k] = GROUP_OF(post->group, p2[i]) + 2;
+                qlen[k] = 4;
+            }
+            break;
+    }
+    dist_cycle(idx, qa, qb, qlen, n, out);
+}
+
+void dist_cycle(const int32_t *idx, int32_t *a, const int32_t *b,
+                const int32_t *len, int32_t n, int64_t *out)
+{   /* grava em out[idx[k]] a distância entre as posições a[k] e b[k] de um
+       ciclo de len[k] posições, k = 0, ..., n-1; o primeiro laço não tem
+       desvios e é vetorizado pelo compilador com as instruções disponíveis
+       (SSE ou AVX2), e a versão escalar é o próprio laço */
+
+    int32_t d;
+
+    for (int32_t k = 0; k < n; k++) {
+        d = a[k] - b[k];
+        d = d < 0 ? -d : d;
+        a[k] = len[k] - d < d ? len[k] - d : d;
+    }
+    for (int32_t k = 0; k < n; k++) out[idx[k]] = a[k];
+}
+
+int64_t get_dist(Fleet *fleet, int32_t p1, int32_t p2)
+{   /* assume que todas as naves correspondem exatamente às características
+       até então conhecidas do seu tipo; retorna FLEET_INF se p1 e p2 não
+       estão na mesma nave e -1 se a nave é de tipo desconhecido ou se não
+       foi possível alocar memória para o atributo jump */
+
+    Posts *post = &fleet->post;
+    Ship *ship = &fleet->ship[post->ship[p1]];
+    int32_t *depth = post->depth;
+    int32_t lca;
+    int32_t i, j, k;
+
+    /* se p1 e p2 não estão na mesma nave */
+    if (post->ship[p1] != post->ship[p2]) return FLEET_INF;
+
+    switch (ship->type)
+    {   /* para entender as fórmulas, consulte a documentação */
+        case FLEET_SCOUT:
+            METRIC_ADD(query[FLEET_SCOUT], 1);
+            return abs(post->pos[p1] - post->pos[p2]);
+
+        case FLEET_FRIGATE:
+            METRIC_ADD(query[FLEET_FRIGATE], 1);
+            if (fleet->lca == FLEET_LCA_RMQ && fleet->lca_pre[p1] != NIL) {
+                /* o pai de rmq_child(p1, p2) é o ancestral comum */
+                if (p1 == p2) return 0;
+                lca = rmq_child(fleet, p1, p2);
+                return depth[p1] + depth[p2] - 2 * depth[lca] + 2;
+            }
+            if (post->jump[p1] == ND && set_jump(fleet, ship) < 0) return -1;
+            lca = get_lca(fleet, p1, p2);
+            return depth[p1] + depth[p2] - 2 * depth[lca];
+
+        case FLEET_TRANSPORT:
+            METRIC_ADD(query[FLEET_TRANSPORT], 1);
+            if (post->pos[p1] != NIL) {
+                i = abs(post->pos[p1] - post->pos[p2]);
+                return min(i, ship->npost - i);
+            }
+            /* transportador que não é um ciclo simples */
+            i = min(depth[p1], depth[p2]);
+            j = max(depth[p1], depth[p2]);
+            k = ship->height;
+            return min(j - i, k - j + i);
+
+        case FLEET_BOMBER:
+            METRIC_ADD(query[FLEET_BOMBER], 1);
+            if (GROUP_OF(post->group, p1) == GROUP_OF(post->group, p2)) {
+                if (p1 == p2) return 0;
+                else return 2;
+            }
+            return 1;
+
+        default:
+            /* Erro! Nave de tipo desconhecido */
+            return -1;
+    }
+}
+
+int32_t set_jump(Fleet *fleet, Ship *ship)
+{   /* configura o atributo jump dos postos da nave com base na decomposição
+       SQRT da árvore que a representa, de cima para baixo, com uma pilha;
+       retorna -3 se não foi possível alocar memória */
+
+    int32_t *pi = fleet->post.pi;
+    int32_t *depth = fleet->post.depth;
+    int32_t *jump = fleet->post.jump;
+    int32_t block_sz = sqrt(ship->height);
+    int32_t *stack;
+    int32_t idx = 0, u, v;
+
+    if ((stack = malloc(ship->npost * sizeof(int32_t))) == NULL) return -3;
+
+    METRIC_ADD(jump_ships, 1);
+    /* a raiz está no primeiro nível do seu bloco */
+    jump[ship->root] = NIL;
+    stack[idx++] = ship->root;
+    while (idx > 0) {
+        u = stack[--idx];
+        for (int32_t i = fleet->adj_idx[u]; i < fleet->adj_end[u]; i++) {
+            v = fleet->adj[i];
+            /* jump = ND também evita empilhar v de novo por um teleporte
+               repetido */
+            if (pi[v] != u || jump[v] != ND) continue;
+            if (depth[v] % block_sz == 0) {
+                /* o posto está no primeiro nível do bloco */
+                jump[v] = u;
+            } else {
+                jump[v] = jump[u];
+            }
+            stack[idx++] = v;
+        }
+    }
+    free(stack);
+
+    return 0;
+}
+
+int32_t get_lca(Fleet *fleet, int32_t p1, int32_t p2)
+{   /* retorna o ancentral comum mais baixo entre p1 e p2 com base na
+       decomposição SQRT da árvore que representa a nave */
+
+    int32_t *pi = fleet->post.pi;
+    int32_t *depth = fleet->post.depth;
+    int32_t *jump = fleet->post.jump;
+
+    while (jump[p1] != jump[p2]) {
+        METRIC_ADD(lca_jump, 1);
+        if (depth[p1] > depth[p2]) p1 = jump[p1];
+        else p2 = jump[p2];
+    }
+    while (p1 != p2) {
+        METRIC_ADD(lca_parent, 1);
+        if (depth[p1] > depth[p2]) p1 = pi[p1];
+        else p2 = pi[p2];
+    }
+    return p1;
+}
+
+int32_t rmq_build(Fleet *fleet)
+{   /* numera em pré-ordem os postos das fragatas, uma nave após a outra, e
+       monta a tabela esparsa sobre essa ordem; os reconhecimentos, também em
+       árvore, são respondidos pela posição dos postos e ficam de fora;
+       retorna -3 se não foi possível alocar memória */
+
+    int32_t *pi = fleet->post.pi;
+    int32_t *depth = fleet->post.depth;
+    int32_t *pre, *tbl, *stack, *lo, *hi;
+    int32_t n = 0, nlev = 0, idx, u, v;
+
+    for (Ship *ship = fleet->ship; ship < fleet->ship + fleet->nship; ship++) {
+        if (ship->type == FLEET_FRIGATE) n += ship->npost;
+    }
+    while (nlev < 31 && (INT32_C(1) << nlev) <= n) nlev++;
+
+    pre = malloc(fleet->npost * sizeof(int32_t));
+    tbl = malloc(((size_t)nlev * n + 1) * sizeof(int32_t));
+    stack = malloc(fleet->npost * sizeof(int32_t));
+    if (pre == NULL || tbl == NULL || stack == NULL) {
+        free(pre); free(tbl); free(stack);
+        return -3;
+    }
+    for (int32_t i = 0; i < fleet->npost; i++) pre[i] = NIL;
+
+    /* nível 0: a própria pré-ordem; um posto é marcado com ND ao ser
+       empilhado, para que teleportes repetidos não o empilhem de novo */
+    n = 0;
+    for (Ship *ship = fleet->ship; ship < fleet->ship + fleet->nship; ship++) {
+        if (ship->type != FLEET_FRIGATE) continue;
+        stack[0] = ship->root;
+        pre[ship->root] = ND;
+        idx = 1;
+        while (idx > 0) {
+            u = stack[--idx];
+            pre[u] = n;
+            tbl[n++] = u;
+            for (int32_t i = fleet->adj_idx[u]; i < fleet->adj_end[u]; i++) {
+                v = fleet->adj[i];
+                if (pi[v] == u && pre[v] == NIL) {
+                    pre[v] = ND;
+                    stack[idx++] = v;
+                }
+            }
+        }
+    }
+    free(stack);
+
+    /* nível j: o mais raso entre os postos de dois intervalos do nível j-1 */
+    for (int32_t j = 1; j < nlev; j++) {
+        lo = &tbl[(size_t)(j - 1) * n];
+        hi = &tbl[(size_t)(j - 1) * n + (INT32_C(1) << (j - 1))];
+        for (int32_t i = 0; i + (INT32_C(1) << j) <= n; i++) {
+            u = lo[i];
+            v = hi[i];
+            tbl[(size_t)j * n + i] = depth[u] <= depth[v] ? u : v;
+        }
+    }
+    free(fleet->lca_pre); free(fleet->lca_tbl);
+    fleet->lca_pre = pre;
+    fleet->lca_tbl = tbl;
+    fleet->lca_n = n;
+    fleet->lca_nlev = nlev;
+
+    return 0;
+}
+
+inline int32_t rmq_child(Fleet *fleet, int32_t p1, int32_t p2)
+{   /* retorna o filho, no caminho para p1 ou p2, do ancestral comum mais
+       baixo entre os postos distintos p1 e p2 de uma mesma fragata;
+       sendo a < b as posições de p1 e p2 na pré-ordem, esse filho é o posto
+       de menor profundidade entre as posições a + 1, ..., b */
+
+    int32_t *depth = fleet->post.depth;
+    int32_t a = fleet->lca_pre[p1];
+    int32_t b = fleet->lca_pre[p2];
+    int32_t j, u, v;
+
+    if (a > b) { j = a; a = b; b = j; }
+    a++;
+    j = 31 - __builtin_clz(b - a + 1);
+    u = fleet->lca_tbl[(size_t)j * fleet->lca_n + a];
+    v = fleet->lca_tbl[(size_t)j * fleet->lca_n + b - (INT32_C(1) << j) + 1];
+
+    return depth[u] <= depth[v] ? u : v;
+}
+
+void heap_fix(FleetQuery *query, int32_t i)
+{   /* restaura o heap mínimo de naves após a alteração da soma da nave na
+       posição i, subindo-a ou descendo-a */
+
+    int32_t *heap = query->heap, *hpos = query->hpos;
+    int64_t *s = query->s;
+    int32_t k = heap[i];
+
+    if (i == 0 || s[heap[(i - 1) / 2]] <= s[k]) {
+        heap_down(query, i);
+        return;
+    }
+    while (i > 0 && s[heap[(i - 1) / 2]] > s[k]) {
+        heap[i] = heap[(i - 1) / 2];
+        hpos[heap[i]] = i;
+        i = (i - 1) / 2;
+    }
+    heap[i] = k;
+    hpos[k] = i;
+}
+
+void heap_down(FleetQuery *query, int32_t i)
+{   /* desce a nave da posição i do heap mínimo de naves, cujas subárvores já
+       são heaps */
+
+    int32_t *heap = query->heap, *hpos = query->hpos;
+    int64_t *s = query->s;
+    int32_t n = query->fleet->nship;
+    int32_t k = heap[i], c;
+
+    while ((c = 2 * i + 1) < n) {
+        if (c + 1 < n && s[heap[c + 1]] < s[heap[c]]) c++;
+        if (s[heap[c]] >= s[k]) break;
+        heap[i] = heap[c];
+        hpos[heap[i]] = i;
+        i = c;
+    }
+    heap[i] = k;
+    hpos[k] = i;
+}
+
+int32_t batch_tree(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                   int32_t n, int64_t *out)
+{   /* baseado no algoritmo offline de Tarjan para ancestral comum mais baixo:
+       quando a busca em profundidade termina um posto u, cada consulta (u, w)
+       ainda pendente em que w já foi visitado é respondida pela raiz do
+       conjunto de w, que é o ancestral de w mais profundo ainda não
+       terminado; em seguida, u é unido ao conjunto do seu pai. Responde as
+       consultas marcadas com ND em out, que são todas de fragatas, e retorna
+       -3 se não foi possível alocar memória */
+
+    int32_t *pi = fleet->post.pi;
+    int32_t *depth = fleet->post.depth;
+    int32_t npost = fleet->npost;
+    int32_t *qoff, *qidx;   /* consultas do posto u: qidx[qoff[u]..] */
+    int32_t *uf;            /* conjuntos da união-busca; NIL se não visitado */
+    int32_t *next;          /* próximo destino a examinar na lista de u */
+    int32_t *stack;         /* pilha da busca em profundidade */
+    int32_t nq = 0, idx, u, v, w;
+
+    for (int32_t i = 0; i < n; i++) nq += out[i] == ND;
+
+    qoff = calloc(npost + 1, sizeof(int32_t));
+    qidx = malloc(2 * (size_t)nq * sizeof(int32_t));
+    uf = malloc(npost * sizeof(int32_t));
+    next = malloc(npost * sizeof(int32_t));
+    stack = malloc(npost * sizeof(int32_t));
+    if (qoff == NULL || qidx == NULL || uf == NULL
+        || next == NULL || stack == NULL) {
+        free(qoff); free(qidx); free(uf); free(next); free(stack);
+        return -3;
+    }
+
+    /* cada consulta pendente é associada aos seus dois postos; next serve de
+       cursor para o preenchimento */
+    for (int32_t i = 0; i < n; i++) {
+        if (out[i] != ND) continue;
+        qoff[p1[i] + 1]++;
+        qoff[p2[i] + 1]++;
+    }
+    for (int32_t i = 0; i < npost; i++) {
+        qoff[i + 1] += qoff[i];
+        next[i] = qoff[i];
+        uf[i] = NIL;
+    }
+    for (int32_t i = 0; i < n; i++) {
+        if (out[i] != ND) continue;
+        qidx[next[p1[i]]++] = i;
+        qidx[next[p2[i]]++] = i;
+    }
+
+    for (Ship *ship = fleet->ship; ship < fleet->ship + fleet->nship; ship++) {
+        if (ship->type != FLEET_FRIGATE) continue;
+        u = ship->root;
+        uf[u] = u;
+        next[u] = fleet->adj_idx[u];
+        stack[0] = u;
+        idx = 1;
+        while (idx > 0) {
+            u = stack[idx - 1];
+            if (next[u] < fleet->adj_end[u]) {
+                /* desce para o próximo filho ainda não visitado */
+                v = fleet->adj[next[u]++];
+                if (pi[v] == u && uf[v] == NIL) {
+                    uf[v] = v;
+                    next[v] = fleet->adj_idx[v];
+                    stack[idx++] = v;
+                }
+                continue;
+            }
+            /* u terminou */
+            idx--;
+            for (int32_t q = qoff[u]; q < qoff[u + 1]; q++) {
+                int32_t i = qidx[q];
+                if (out[i] != ND) continue;
+                w = p1[i] == u ? p2[i] : p1[i];
+                if (uf[w] == NIL) continue;
+                v = uf_root(uf, w);
+                out[i] = depth[u] + depth[w] - 2 * depth[v];
+            }
+            if (pi[u] != NIL) uf[u] = pi[u];
+        }
+    }
+    free(qoff); free(qidx); free(uf); free(next); free(stack);
+
+    return 0;
+}
+
+inline int32_t uf_root(int32_t *uf, int32_t u)
+{   /* retorna a raiz do conjunto de u, encurtando o caminho pela metade */
+
+    while (uf[u] != u) {
+        uf[u] = uf[uf[u]];
+        u = uf[u];
+    }
+    return u;
+}
+
+#ifdef FLEET_METRICS
+double metric_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void metric_flush(Fleet *fleet)
+{   /* soma os contadores da thread aos da frota e os zera */
+
+    FleetMetrics *m = &fleet->metrics;
+
+    pthread_mutex_lock(&metric_lock);
+    m->edges += metric_local.edges;
+    m->lca_jump += metric_local.lca_jump;
+    m->lca_parent += metric_local.lca_parent;
+    m->jump_ships += metric_local.jump_ships;
+    for (int32_t t = 0; t < FLEET_NTYPE; t++) {
+        m->query[t] += metric_local.query[t];
+    }
+    m->pruned += metric_local.pruned;
+    m->early += metric_local.early;
+    pthread_mutex_unlock(&metric_lock);
+    memset(&metric_local, 0, sizeof(FleetMetrics));
+}
+#endif
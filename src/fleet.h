@@ -14,19 +14,26 @@
 #ifndef _FLEET_H_
 #define _FLEET_H_
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
-/* limites para postos de combate por frota */
+/* limites para postos de combate por frota: com no máximo INT32_MAX / 2
+   postos e teleportes, todo índice, inclusive nas listas de adjacências,
+   cabe em int32_t */
 #define FLEET_MINPOST   10
-#define FLEET_MAXPOST   100000
+#define FLEET_MAXPOST   (INT32_MAX / 2)
 
 /* limites para teleportes por frota */
 #define FLEET_MINTP     8
-#define FLEET_MAXTP     1000000
+#define FLEET_MAXTP     (INT32_MAX / 2)
 
 /* representação para valor infinito */
 #define FLEET_INF       INT64_MAX
 
+/* versão do formato de imagem binária gravado por fleet_save() */
+#define FLEET_IMGVER    4
+
 /* tipos de nave da frota */
 #define FLEET_SCOUT     0   /* reconhecimento */
 #define FLEET_FRIGATE   1   /* fragata */
@@ -34,25 +41,130 @@
 #define FLEET_TRANSPORT 3   /* transportador */
 #define FLEET_NTYPE     4   /* quantidades de tipos de nave */
 
+/* índices de ancestral comum mais baixo nas naves em árvore */
+#define FLEET_LCA_SQRT  0   /* decomposição SQRT, montada sob demanda */
+#define FLEET_LCA_RMQ   1   /* pré-ordem e tabela esparsa: consulta em O(1) */
+
 typedef struct Fleet Fleet;
 typedef struct Ship Ship;
 typedef struct Post Post;
+typedef struct Posts Posts;
 typedef struct Teleport Teleport;
+typedef struct FleetMetrics FleetMetrics;
+typedef struct FleetQuery FleetQuery;
+typedef struct FleetWork FleetWork;
+
+/* função que lê os próximos n teleportes de uma frota para p1[0..n-1] e
+   p2[0..n-1], com os postos na base 0, e retorna quantos leu */
+typedef int32_t (*FleetReadFn)(void *arg, int32_t *p1, int32_t *p2, int32_t n);
+
+struct Posts {          /* postos de combate, um vetor por atributo */
+    int32_t *ship;      /* id da nave a que cada posto pertence */
+
+    /* atributos do vértice que representa cada posto na árvore da nave */
+    int32_t *pi;        /* pai do posto */
+    int32_t *depth;     /* profundidade do posto */
+    uint64_t *group;    /* grupo do posto p: bit p % 64 de group[p / 64] */
+
+    /* atributo utilizado na decomposição SQRT da árvore da nave e na posterior
+       obtenção de ancestral comum mais baixo */
+    int32_t *jump;
+
+    /* posição do posto ao longo do caminho de um reconhecimento ou do ciclo
+       de um transportador, de 0 a npost - 1 da nave, ou -1 nas demais naves;
+       a distância entre dois postos é a diferença entre as posições, tomada
+       nos dois sentidos no caso do ciclo */
+    int32_t *pos;
+};
+
+struct FleetMetrics {   /* instrumentação, mantida apenas se a biblioteca é
+                           compilada com FLEET_METRICS definido */
+    /* tempo acumulado, em segundos, pelas funções de cada fase */
+    double t_scan;      /* fleet_scan(), fleet_pscan() e fleet_xscan() */
+    double t_relabel;   /* fleet_relabel() */
+    double t_index;     /* fleet_index() */
+    double t_adtm;      /* fleet_adtm() e fleet_padtm() */
+    double t_batch;     /* fleet_dist_batch() */
+
+    int64_t edges;      /* entradas das listas de adjacências percorridas
+                           pelas buscas em profundidade da exploração */
+    int64_t lca_jump;   /* passos pelo atributo jump na decomposição SQRT */
+    int64_t lca_parent; /* passos pelo pai na decomposição SQRT */
+    int64_t jump_ships; /* naves cujo atributo jump foi montado */
+    int64_t query[FLEET_NTYPE];  /* distâncias, ou cotas, por tipo de nave */
+    int64_t pruned;     /* somas de nave descartadas ou interrompidas por não
+                           poderem reduzir a menor soma m */
+    int64_t early;      /* paradas antecipadas ao encontrar m <= 1 */
+};
 
 struct Fleet {          /* frota de naves */
     int32_t nship;      /* número de naves */
-    Ship *ship;         /* lista de naves */
+    int32_t mship;      /* capacidade do vetor de naves */
+    Ship *ship;         /* vetor de naves, indexado por id: NULL enquanto a
+                           frota não é explorada */
     int32_t npost;      /* número de postos de combate */
-    Post *post;         /* vetor de postos de combate */
+    int32_t mpost;      /* capacidade dos vetores de postos e de adj_idx */
+    Posts post;         /* postos de combate */
     int32_t ntp;        /* número de teleportes possíveis */ 
-    Teleport *tp;       /* vetor de teleportes possíveis */
+    int32_t mtp;        /* capacidade do vetor tp */
+    Teleport *tp;       /* vetor de teleportes possíveis: NULL se a frota
+                           foi explorada por fleet_xscan() */
+
+    /* listas de adjacências: os destinos dos teleportes possíveis a partir
+       do posto p são adj[adj_idx[p]], ..., adj[adj_end[p] - 1]; após a
+       exploração, as listas ficam compactadas (CSR), com adj_end[p] igual a
+       adj_idx[p + 1], e fleet_link() e fleet_unlink() as alteram no lugar,
+       copiando para o fim de adj a lista que não tem mais espaço livre */
+    int32_t madj;       /* capacidade do vetor adj */
+    int32_t *adj_idx;   /* vetor de npost + 1 deslocamentos em adj: o início
+                           de cada lista e, na última posição, o fim da
+                           parte usada de adj */
+    int32_t *adj_end;   /* vetor de npost deslocamentos: o fim de cada lista */
+    int32_t *adj_lim;   /* limite de cada lista: NULL enquanto nenhuma lista
+                           foi copiada, caso em que o limite da lista de p é
+                           adj_idx[p + 1] */
+    int32_t *adj;       /* vetor de destinos */
+
+    /* índice de ancestral comum mais baixo selecionado por fleet_index():
+       com FLEET_LCA_RMQ, os postos das fragatas são numerados em pré-ordem
+       e lca_tbl[j * lca_n + i] é o posto de menor profundidade entre as
+       posições i, ..., i + 2^j - 1 dessa ordem */
+    int32_t lca;        /* FLEET_LCA_SQRT ou FLEET_LCA_RMQ */
+    int32_t lca_n;      /* número de postos em fragatas */
+    int32_t lca_nlev;   /* número de níveis da tabela esparsa */
+    int32_t *lca_pre;   /* posição de cada posto na pré-ordem */
+    int32_t *lca_tbl;   /* tabela esparsa com lca_nlev * lca_n postos */
+
+    /* numeração dos postos após fleet_relabel(): o posto de id original p
+       ocupa a posição label[p] dos vetores da frota, e a posição i é ocupada
+       pelo posto de id original origin[i]; ambos são NULL enquanto a frota
+       mantém a numeração da entrada */
+    int32_t *label;
+    int32_t *origin;
+
+    /* imagem mapeada por fleet_load(): os vetores de naves, de postos e de
+       teleportes, adj_idx, adj e label apontam para as suas seções, e os
+       que precisam crescer são copiados para fora dela; NULL se a frota não
+       foi carregada de uma imagem */
+    void *img;
+    size_t img_size;    /* tamanho da imagem em bytes */
+
+    FleetMetrics metrics;   /* instrumentação, zerada por fleet_init() */
 };
 
-struct Ship {       /* lista de naves de uma frota */
-    int32_t id;     /* id da nave na frota: de 0 a nship - 1 */
+struct FleetQuery {     /* consulta incremental do tempo de vantagem, com os
+                           postos na numeração interna da frota */
+    Fleet *fleet;       /* frota consultada, que não deve ser alterada */
+    int32_t *target;    /* posto de destino do tripulante de cada posto */
+    int32_t *dist;      /* distância de cada posto ao seu destino */
+    int64_t *s;         /* soma das distâncias por nave */
+    int32_t *heap;      /* heap mínimo das naves por soma */
+    int32_t *hpos;      /* posição de cada nave em heap */
+};
+
+struct Ship {       /* nave de uma frota: o id é a sua posição no vetor */
     int32_t type;   /* tipo da nave */
     int32_t npost;  /* número de postos de combate na nave */
-    Ship *next;     /* próxima nave na lista */
 
     /* atributos da árvore que representa a nave na floresta de busca em 
        profundidade */
@@ -60,23 +172,18 @@ struct Ship {       /* lista de naves de uma frota */
     int32_t height; /* altura */
 };
 
-struct Post {       /* posto de combate */
-    Ship *ship;     /* nave a que pertence */
-    Teleport *tp;   /* lista dos teleportes possíveis a partir deste posto */
-
-    /* atributos do vértice que representa o posto na árvore da nave */
+struct Post {       /* posto de combate, como obtido por fleet_post() */
+    int32_t ship;   /* id da nave a que pertence */
     int32_t pi;     /* pai do posto */
     int32_t depth;  /* profundidade do posto */
     int8_t group;   /* grupo do posto */
-
-    /* atributo utilizado na decomposição SQRT da árvore da nave e na posterior
-       obtenção de ancestral comum mais baixo */
-    int32_t jump;
+    int32_t jump;   /* atributo da decomposição SQRT */
+    int32_t pos;    /* posição no caminho ou ciclo da nave, ou -1 */
 };
 
-struct Teleport {   /* lista de teleportes possíveis a partir de um posto */
-    int32_t to;     /* posto de combate que é destino do teleporte */
-    Teleport *next; /* próximo teleporte na lista */
+struct Teleport {   /* teleporte possível entre dois postos de combate */
+    int32_t p1;     /* primeiro posto: -1 se o teleporte não foi adicionado */
+    int32_t p2;     /* segundo posto */
 };
 
 /*
@@ -84,11 +191,32 @@ struct Teleport {   /* lista de teleportes possíveis a partir de um posto */
  * combate e ntp teleportes possíveis. Em caso de sucesso, a função retorna 
  * 0. Em caso de falha, ela retorna:
  *  -1: se fleet é NULL;
- *  -2: se npost ou ntp está fora dos limites suportados; ou
- *  -3: se não foi possível alocar memória.
+ *  -2: se npost está fora dos limites suportados;
+ *  -3: se ntp está fora dos limites suportados;
+ *  -4: se não foi possível alocar os vetores de postos de combate; ou
+ *  -5: se não foi possível alocar o vetor de teleportes ou as listas de
+ *      adjacências.
  */
 int32_t fleet_init(Fleet *fleet, int32_t npost, int32_t ntp);
 
+/*
+ * fleet_reset: reinicializa o objeto apontado por fleet com npost postos de
+ * combate e ntp teleportes possíveis, como fleet_init(), descartando a frota
+ * anterior, mas reaproveitando os vetores de postos, de teleportes e das
+ * listas de adjacências se eles comportam a nova frota; caso contrário, eles
+ * são realocados com a maior das capacidades. Assim, uma sequência de frotas
+ * processadas com um mesmo objeto não aloca esses vetores a cada frota. Se
+ * fleet->post.ship é NULL, como após fleet_free() ou em um objeto zerado, a
+ * função equivale a fleet_init(). Em caso de sucesso, a função retorna 0. Em
+ * caso de falha, ela retorna:
+ *  -1: se fleet é NULL;
+ *  -2: se npost está fora dos limites suportados;
+ *  -3: se ntp está fora dos limites suportados; ou
+ *  -4 ou -5: se não foi possível alocar os vetores, como em fleet_init();
+ *      nesse caso, o objeto fica liberado como após fleet_free().
+ */
+int32_t fleet_reset(Fleet *fleet, int32_t npost, int32_t ntp);
+
 /*
  * fleet_add: adiciona um teleporte possível entre os pontos de combate p1 e 
  * p2 a uma frota assumidamente inicializada apontada por fleet. O teleporte 
@@ -97,22 +225,155 @@ int32_t fleet_init(Fleet *fleet, int32_t npost, int32_t ntp);
  *  -1: se fleet não é um objeto Fleet válido;
  *  -2: se idx está fora dos limites do vetor de teleportes;
  *  -3: se p1 ou p2 está fora dos limites do vetor de postos de combate; ou
- *  -4: se a frota já foi explorada.
+ *  -4: se a frota já foi explorada; nesse caso, use fleet_link().
  */
 int32_t fleet_add(Fleet *fleet, int32_t idx, int32_t p1, int32_t p2);
 
 /*
  * fleet_scan: explora a frota apontada por fleet. A função assume que fleet
  * foi inicializado e que todos os teleportes possíveis entre postos já foram 
- * adicionados. Em caso de sucesso, a função identifica, descreve e classifica 
- * todas as naves da frota, retornando a contagem delas. Em caso de falha, ela
- * retorna:
+ * adicionados. Antes da exploração, a função compacta as listas de adjacências
+ * da frota em fleet->adj_idx e fleet->adj, preservando a ordem decrescente de
+ * índice dos teleportes. Em caso de sucesso, a função identifica, descreve e
+ * classifica todas as naves da frota, retornando a contagem delas. Em caso de
+ * falha, ela retorna:
  *  -1: se fleet não é um objeto Fleet válido;
  *  -2: se a frota já foi explorada; ou
- *  -3: se não foi possível alocar memória.
+ *  -3: se não foi possível alocar memória; nesse caso, a frota volta ao
+ *      estado anterior à exploração e pode ser explorada de novo.
  */
 int32_t fleet_scan(Fleet *fleet);
 
+/*
+ * fleet_pscan: equivalente a fleet_scan(), mas com até nthread threads. As
+ * naves são identificadas por uma união-busca concorrente sobre o vetor de
+ * teleportes, em que a raiz de cada conjunto é o seu posto de menor índice,
+ * e depois exploradas em paralelo, cada uma por uma única thread. O resultado
+ * e os códigos de retorno são idênticos aos de fleet_scan(), que é usada
+ * diretamente quando a frota é pequena demais para ser dividida.
+ */
+int32_t fleet_pscan(Fleet *fleet, int32_t nthread);
+
+/*
+ * fleet_xscan: inicializa o objeto apontado por fleet com npost postos de
+ * combate e o explora, como fleet_init(), fleet_add() e fleet_scan(), mas sem
+ * manter os ntp teleportes possíveis em memória, para frotas cujo vetor de
+ * teleportes não cabe nela. Os teleportes são obtidos, em ordem, por chamadas
+ * read(arg, p1, p2, n) e lidos uma única vez: as naves são identificadas por
+ * uma união-busca sobre os postos enquanto os teleportes são copiados para um
+ * arquivo temporário; depois, eles são redistribuídos por grupos de naves
+ * consecutivas com até mem / 16 teleportes, salvo uma nave maior, e cada
+ * grupo é carregado e explorado de uma vez. Assim, além dos grupos, só ficam
+ * em memória vetores proporcionais a npost e ao número de grupos. As naves,
+ * seus ids e os atributos dos postos são idênticos aos de fleet_scan(), e o
+ * atributo jump das fragatas já é montado durante a exploração. Como os
+ * teleportes não são mantidos, fleet->tp, fleet->adj_idx e fleet->adj são
+ * NULL, e a frota só pode ser usada em fleet_stat(), fleet_post(),
+ * fleet_adtm(), fleet_padtm(), fleet_dist_batch() e fleet_metrics(); as
+ * demais funções a tratam como um objeto Fleet inválido. Em caso de sucesso,
+ * a função retorna a contagem de naves. Em caso de falha, o objeto fica
+ * liberado como após fleet_free() e a função retorna:
+ *  -1: se fleet ou read é NULL;
+ *  -2: se npost ou ntp está fora dos limites suportados;
+ *  -3: se não foi possível alocar memória;
+ *  -4: se read retornou menos teleportes que o pedido ou um teleporte com
+ *      posto fora dos limites; ou
+ *  -5: se não foi possível criar, gravar ou ler um arquivo temporário.
+ */
+int32_t fleet_xscan(Fleet *fleet, int32_t npost, int32_t ntp,
+                    FleetReadFn read, void *arg, size_t mem);
+
+/*
+ * fleet_count: obtém a contagem de naves por tipo de uma frota com npost
+ * postos de combate e ntp teleportes possíveis, como fleet_stat() após a
+ * exploração, mas sem montar a frota. Os teleportes são obtidos, em ordem,
+ * por chamadas read(arg, p1, p2, n), como em fleet_xscan(), e percorridos uma
+ * única vez por uma união-busca sobre os postos, que conta o grau de cada
+ * posto. Para classificar uma nave, bastam o seu número de postos, de
+ * teleportes e o seu grau máximo; logo, nem as listas de adjacências nem as
+ * árvores das naves são montadas, e só ficam em memória vetores
+ * proporcionais a npost. A função assume que não há teleportes repetidos nem
+ * teleportes de um posto para ele mesmo. Para i = 0, ..., FLEET_NTYPE-1, a
+ * função grava a contagem de naves do tipo i em stat[i]. Em caso de sucesso,
+ * ela retorna o número total de naves. Em caso de falha, ela retorna:
+ *  -1: se read ou stat é NULL;
+ *  -2: se npost ou ntp está fora dos limites suportados;
+ *  -3: se não foi possível alocar memória; ou
+ *  -4: se read retornou menos teleportes que o pedido ou um teleporte com
+ *      posto fora dos limites.
+ */
+int32_t fleet_count(int32_t npost, int32_t ntp, FleetReadFn read, void *arg,
+                    int32_t *stat);
+
+/*
+ * fleet_link: adiciona um teleporte entre os postos de combate p1 e p2 na
+ * posição idx, ainda livre, do vetor de teleportes da frota apontada por
+ * fleet, que já deve ter sido explorada; se idx não é menor que fleet->ntp,
+ * o vetor passa a ter idx + 1 posições, e as novas posições ficam livres. Em
+ * vez de explorar de novo toda a frota, a função explora apenas as naves de
+ * p1 e p2, que passam a formar uma só nave, com o menor dos dois ids; se as
+ * naves eram distintas, a última nave da frota passa a ocupar o id que ficou
+ * livre. Os atributos jump dessas naves são refeitos sob demanda, e seus
+ * postos deixam o índice RMQ, se houver, até a próxima chamada de
+ * fleet_index(); as demais naves não são alteradas. Só as listas de
+ * adjacências de p1 e p2 são alteradas, em tempo proporcional ao grau deles,
+ * e os teleportes inseridos dessa forma não seguem a ordem de índice nelas.
+ * Em caso de sucesso, a função retorna a contagem de naves da frota. Em caso
+ * de falha, a frota não é alterada e a função retorna:
+ *  -1: se fleet não é um objeto Fleet válido e já explorado;
+ *  -2: se idx é negativo ou não é menor que FLEET_MAXTP;
+ *  -3: se p1 ou p2 está fora dos limites do vetor de postos de combate;
+ *  -4: se a posição idx já contém um teleporte; ou
+ *  -5: se não foi possível alocar memória.
+ */
+int32_t fleet_link(Fleet *fleet, int32_t idx, int32_t p1, int32_t p2);
+
+/*
+ * fleet_unlink: remove o teleporte da posição idx do vetor de teleportes da
+ * frota apontada por fleet, que já deve ter sido explorada. Apenas a nave do
+ * teleporte é explorada novamente; se ela se divide em duas, a parte que não
+ * contém o primeiro posto do teleporte recebe um novo id, igual à contagem
+ * anterior de naves. Os efeitos sobre os atributos jump, o índice RMQ e as
+ * listas de adjacências são os mesmos de fleet_link(). Em caso de sucesso, a
+ * função retorna a contagem de naves da frota. Em caso de falha, a frota não
+ * é alterada e a função retorna:
+ *  -1: se fleet não é um objeto Fleet válido e já explorado;
+ *  -2: se idx está fora dos limites do vetor de teleportes;
+ *  -4: se a posição idx não contém um teleporte; ou
+ *  -5: se não foi possível alocar memória.
+ */
+int32_t fleet_unlink(Fleet *fleet, int32_t idx);
+
+/*
+ * fleet_relabel: renumera os postos de combate da frota apontada por fleet,
+ * que já deve ter sido explorada, de modo que os postos de cada nave ocupem
+ * posições consecutivas dos vetores da frota, na pré-ordem da árvore da nave,
+ * e que as naves se sucedam em ordem crescente de id. Assim, percorrer uma
+ * nave, seus pais e seus atributos jump acessa regiões próximas da memória.
+ * As funções da biblioteca continuam recebendo e retornando os ids originais
+ * dos postos, traduzidos pelos vetores fleet->label e fleet->origin; já os
+ * vetores da frota, inclusive o atributo root das naves, passam a usar a nova
+ * numeração. Renumerar uma frota já renumerada não tem efeito. Em caso de
+ * sucesso, a função retorna 0. Em caso de falha, a frota não é alterada e a
+ * função retorna:
+ *  -1: se fleet não é um objeto Fleet válido e já explorado; ou
+ *  -3: se não foi possível alocar memória.
+ */
+int32_t fleet_relabel(Fleet *fleet);
+
+/*
+ * fleet_post: grava em post os atributos do posto de combate p da frota
+ * apontada por fleet, que já deve ter sido explorada. Os atributos são
+ * mantidos em vetores separados, um por atributo, para que cada algoritmo
+ * carregue da memória apenas os que usa; esta função os reúne em um único
+ * objeto. Em caso de sucesso, a função retorna 0. Em caso de falha, ela
+ * retorna:
+ *  -1: se fleet não é um objeto Fleet válido e já explorado ou se post é
+ *      NULL; ou
+ *  -2: se p está fora dos limites do vetor de postos de combate.
+ */
+int32_t fleet_post(Fleet *fleet, int32_t p, Post *post);
+
 /*
  * fleet_stat: retorna a contagem de naves por tipo. A função assume que fleet 
  * aponta para um objeto Fleet que já foi explorado por fleet_scan() e que stat 
@@ -131,20 +392,199 @@ int32_t fleet_stat(Fleet *fleet, int32_t *stat);
  * ao seu posto correto p2[i] para todo i = 0, ..., npost-1; que para cada posto
  * i da frota existe um e apenas um par (j, k) tal que i = p1[j] = p2[k]; que um 
  * teleporte demora uma unidade de tempo; e que só pode ser realizado um único
- * teleporte por vez em cada nave. Em caso de sucesso, a funcão retorna uma 
- * cota inferior >= 0. Em caso de falha, ela returna:
+ * teleporte por vez em cada nave. Primeiro, a função obtém para cada nave,
+ * com O(1) operações por par, uma cota inferior da soma das distâncias entre
+ * os postos, que é exata exceto nas fragatas. Depois, as fragatas cuja cota é
+ * menor que a menor soma já encontrada são avaliadas por completo, em ordem
+ * crescente de cota e com o índice selecionado por fleet_index(), até que
+ * nenhuma delas possa reduzir a resposta. Em caso de sucesso, a funcão
+ * retorna uma cota inferior >= 0. Em caso de falha, ela returna:
  *  -1: se fleet não é um objeto Fleet válido;
  *  -2: se p1[i] ou p2[i] está fora dos limites do vetor de postos de combate
- *      para algum i; ou
+ *      para algum i;
  *  -3: se p1[i] e p2[i] não estão na mesma nave para algum i ou se a nave é 
- *      de tipo desconhecido.
+ *      de tipo desconhecido; ou
+ *  -4: se não foi possível alocar memória.
  */
 int64_t fleet_adtm(Fleet *fleet, int32_t *p1, int32_t *p2);
 
+/*
+ * fleet_dist_batch: calcula, para i = 0, ..., n-1, o tempo necessário para
+ * levar um tripulante do posto p1[i] ao posto p2[i] da frota apontada por
+ * fleet, que já deve ter sido explorada, e o grava em out[i]. Se p1[i] e p2[i]
+ * não estão na mesma nave, out[i] recebe FLEET_INF; se a nave é de tipo
+ * desconhecido, out[i] recebe -1. As consultas são agrupadas por tipo de nave
+ * com uma ordenação por contagem, e cada grupo é respondido por um laço
+ * próprio. As consultas às fragatas são respondidas em uma única passada pelo
+ * algoritmo offline de Tarjan, que visita cada posto uma única vez,
+ * independentemente do índice selecionado por fleet_index(). Em caso de
+ * sucesso, a função retorna 0. Em caso de falha, ela retorna:
+ *  -1: se fleet não é um objeto Fleet válido e já explorado;
+ *  -2: se n < 0, se p1, p2 ou out é NULL, ou se p1[i] ou p2[i] está fora dos
+ *      limites do vetor de postos de combate para algum i; ou
+ *  -3: se não foi possível alocar memória.
+ */
+int32_t fleet_dist_batch(Fleet *fleet, const int32_t *p1, const int32_t *p2,
+                         int32_t n, int64_t *out);
+
+/*
+ * fleet_padtm: equivalente a fleet_adtm(), mas com até nthread threads. Os
+ * pares (p1[i], p2[i]) são agrupados por nave e divididos em blocos, que as
+ * threads processam sob demanda, das naves com mais pares para as com menos.
+ * A menor soma de distâncias já obtida para uma nave é compartilhada entre as
+ * threads, de modo que a poda de naves e a parada antecipada de fleet_adtm()
+ * continuam valendo. Como todos os pares são validados antes do cálculo, os
+ * códigos de falha -2 e -3 são retornados sempre que algum par é inválido;
+ * para entradas válidas, o resultado é idêntico ao de fleet_adtm(), que é
+ * usada diretamente quando a frota é pequena demais para ser dividida.
+ */
+int64_t fleet_padtm(Fleet *fleet, int32_t *p1, int32_t *p2, int32_t nthread);
+
+/*
+ * fleet_work_new: cria um objeto FleetWork com os vetores de que
+ * fleet_padtm() precisa para calcular o tempo de vantagem em relação à
+ * frota apontada por fleet, já explorada, com até nthread threads. Assim,
+ * quem calcula o tempo de vantagem de várias ocupações da mesma frota, como
+ * o modo servidor, aloca esses vetores uma única vez. Enquanto o objeto for
+ * usado, a frota não deve ser alterada nem liberada. A função retorna NULL
+ * se fleet não é um objeto Fleet válido e já explorado ou se não foi
+ * possível alocar memória.
+ */
+FleetWork *fleet_work_new(Fleet *fleet, int32_t nthread);
+
+/*
+ * fleet_work_adtm: equivalente a fleet_padtm() para a frota e o número de
+ * threads de work, mas sem alocar memória, exceto pelo atributo jump das
+ * fragatas na primeira vez em que ele é necessário. A função retorna os
+ * mesmos valores de fleet_padtm(), e -1 também se work é NULL ou se o
+ * número de naves da frota mudou desde a criação de work.
+ */
+int64_t fleet_work_adtm(FleetWork *work, int32_t *p1, int32_t *p2);
+
+/*
+ * fleet_work_free: libera o objeto FleetWork apontado por work, criado por
+ * fleet_work_new().
+ */
+void    fleet_work_free(FleetWork *work);
+
+/*
+ * fleet_query_init: inicializa o objeto apontado por query para calcular o
+ * tempo de vantagem em relação à frota apontada por fleet, já explorada,
+ * partindo das ocupações p1 e p2 de fleet_adtm() e mantendo a distância de
+ * cada par, a soma das distâncias de cada nave e um heap mínimo das naves
+ * por soma. Assim, fleet_query_update() recalcula o tempo de vantagem após
+ * uma alteração de k destinos em O(k log nship) operações, além das k
+ * distâncias. Enquanto query for usado, a frota não deve ser alterada nem
+ * liberada. Em caso de sucesso, a função retorna o tempo de vantagem, que é o
+ * de fleet_adtm(). Em caso de falha, ela retorna os códigos de fleet_adtm(),
+ * e query não precisa ser liberado.
+ */
+int64_t fleet_query_init(FleetQuery *query, Fleet *fleet, const int32_t *p1,
+                         const int32_t *p2);
+
+/*
+ * fleet_query_update: para i = 0, ..., n-1, nessa ordem, altera para
+ * target[i] o destino do tripulante do posto post[i] na consulta apontada
+ * por query, atualizando apenas as naves afetadas, e retorna o novo tempo de
+ * vantagem. Os destinos não precisam formar uma permutação a cada alteração,
+ * mas o resultado só é um tempo de vantagem quando formam. Em caso de falha,
+ * nenhum destino é alterado e a função retorna:
+ *  -1: se query não foi inicializado por fleet_query_init();
+ *  -2: se n < 0, se post ou target é NULL ou se post[i] ou target[i] está
+ *      fora dos limites do vetor de postos de combate para algum i;
+ *  -3: se post[i] e target[i] não estão na mesma nave para algum i; ou
+ *  -4: se não foi possível alocar memória ou calcular alguma distância.
+ */
+int64_t fleet_query_update(FleetQuery *query, const int32_t *post,
+                           const int32_t *target, int32_t n);
+
+/*
+ * fleet_query_adtm: retorna o tempo de vantagem corrente da consulta
+ * apontada por query, em O(1), ou -1 se query não foi inicializado.
+ */
+int64_t fleet_query_adtm(FleetQuery *query);
+
+/*
+ * fleet_query_free: libera a memória alocada dinamicamente para o objeto
+ * FleetQuery apontado por query.
+ */
+void    fleet_query_free(FleetQuery *query);
+
+/*
+ * fleet_index: seleciona o índice usado por fleet_adtm() e fleet_padtm() para
+ * obter o ancestral comum mais baixo de dois postos de uma fragata; os
+ * reconhecimentos são respondidos pela posição dos postos, sem índice. Com
+ * FLEET_LCA_SQRT, o padrão, o índice é montado sob demanda na primeira
+ * consulta a cada nave e cada consulta custa O(sqrt(h)), em que h é a altura
+ * da nave. Com FLEET_LCA_RMQ, o índice de todas as fragatas é montado
+ * imediatamente, em tempo e espaço O(n log n), em que n é o número de postos
+ * em fragatas, e cada consulta custa O(1), o que compensa quando muitas
+ * permutações são avaliadas na mesma frota. A
+ * função assume que fleet aponta para um objeto Fleet que já foi explorado.
+ * Em caso de sucesso, ela retorna 0. Em caso de falha, o índice selecionado
+ * anteriormente é mantido e a função retorna:
+ *  -1: se fleet não é um objeto Fleet válido e já explorado;
+ *  -2: se method não é FLEET_LCA_SQRT nem FLEET_LCA_RMQ; ou
+ *  -3: se não foi possível alocar memória.
+ */
+int32_t fleet_index(Fleet *fleet, int32_t method);
+
+/*
+ * fleet_index_size: retorna o número de bytes ocupados pelo índice de
+ * ancestral comum mais baixo selecionado na frota apontada por fleet, ou 0 se
+ * fleet é NULL. Para FLEET_LCA_SQRT, esse é o espaço do atributo jump dos
+ * postos de combate.
+ */
+size_t  fleet_index_size(Fleet *fleet);
+
+/*
+ * fleet_save: grava no arquivo de nome path uma imagem binária da frota
+ * apontada por fleet, que já deve ter sido explorada por fleet_scan(). A
+ * imagem é composta por um cabeçalho e por vetores de inteiros de tamanho
+ * fixo, alinhados em 8 bytes: os atributos das naves, os atributos dos postos
+ * de combate, os teleportes e as listas de adjacências. A imagem é gravada
+ * antes no arquivo path seguido de ".tmp", que então substitui path. Em caso
+ * de sucesso, a função retorna 0. Em caso de falha, ela retorna:
+ *  -1: se fleet não é um objeto Fleet válido e já explorado; ou
+ *  -2: se não foi possível gravar o arquivo.
+ */
+int32_t fleet_save(Fleet *fleet, const char *path);
+
+/*
+ * fleet_load: inicializa o objeto apontado por fleet a partir da imagem
+ * gravada por fleet_save() no arquivo de nome path. O arquivo é mapeado em
+ * memória de forma privada e os vetores da frota apontam diretamente para as
+ * seções da imagem, sem cópia: só as páginas alteradas depois ocupam memória
+ * própria do processo, e o arquivo não deve ser truncado enquanto a frota
+ * existir. A frota resultante já está explorada, com o índice
+ * FLEET_LCA_SQRT, e pode ser usada diretamente em fleet_stat() e
+ * fleet_adtm(). Em caso de sucesso,
+ * a função retorna o número de naves da frota. Em caso de falha, ela
+ * retorna:
+ *  -1: se fleet é NULL;
+ *  -2: se não foi possível abrir ou mapear o arquivo;
+ *  -3: se o arquivo não é uma imagem válida na versão FLEET_IMGVER; ou
+ *  -4: se não foi possível alocar memória.
+ */
+int32_t fleet_load(Fleet *fleet, const char *path);
+
 /*
  * fleet_free: libera a memória alocada dinamicamente para o objeto Fleet 
- * apontado por fleet.
+ * apontado por fleet e desfaz o mapeamento da imagem de fleet_load().
  */
 void    fleet_free(Fleet *fleet);
 
+/*
+ * fleet_metrics: grava em out, como um objeto JSON sem quebra de linha ao
+ * final, as métricas acumuladas pela frota apontada por fleet desde a sua
+ * inicialização. As métricas só são mantidas se a biblioteca é compilada com
+ * a macro FLEET_METRICS definida; sem ela, a instrumentação não tem custo, o
+ * objeto informa "ativo": false e todas as métricas são nulas. Em caso de
+ * sucesso, a função retorna 0. Em caso de falha, ela retorna:
+ *  -1: se fleet não é um objeto Fleet válido;
+ *  -2: se out é NULL; ou
+ *  -3: se não foi possível gravar em out.
+ */
+int32_t fleet_metrics(Fleet *fleet, FILE *out);
+
 #endif /* !_FLEET_H_ */
\ No newline at end of file
@@ -0,0 +1,405 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Universidade Federal de Minas Gerais
+ *   Departamento de Ciência da Computação
+ *   Programa de Pós-Graduação em Ciência da Computação
+ *   Projeto e Análise de Algoritmos
+ *
+ *   Trabalho Prático - Grafos
+ *
+ *   Autor: Leandro Augusto Lacerda Campos
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * Gerador de entradas sintéticas para o programa fleet. A frota gerada tem
+ * npost postos, divididos em naves cujos tipos são sorteados com os pesos
+ * dados por -m e cujos tamanhos seguem a distribuição dada por -d:
+ *  - reconhecimento: um caminho;
+ *  - fragata: uma árvore aleatória em que a raiz tem grau 3 ou, com -c, uma
+ *    cadeia com um único ramo, o pior caso para o ancestral comum mais baixo;
+ *  - bombardeiro: um grafo bipartido completo, em que cada um dos até
+ *    BOMBER_SIDE primeiros postos se liga a todos os demais; e
+ *  - transportador: um ciclo.
+ * As ocupações planejadas são uma permutação dos postos de cada nave:
+ * aleatória, a inversão da ordem de geração (uma rotação de meia volta nos
+ * ciclos), que afasta ao máximo os postos nos caminhos e nas cadeias, ou a
+ * identidade. Com -e, os ids dos postos são embaralhados, o que destrói a
+ * localidade da entrada.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "fleet.h"
+
+#define USAGE   "Uso: gerador -n postos [-m r,f,b,t] [-k tamanho] " \
+                "[-d fixo|unif|pot] [-p aleat|inv|ident] [-c] [-e] " \
+                "[-x semente] > entrada\n"
+
+/* tamanho mínimo de uma nave de cada tipo */
+#define MIN_SCOUT       3
+#define MIN_FRIGATE     4
+#define MIN_BOMBER      5   /* K(2,3): um K(2,2) seria um ciclo */
+#define MIN_SHIP        MIN_BOMBER      /* maior dos mínimos acima */
+
+/* tamanho máximo do menor lado de um bombardeiro, que limita o número de
+   teleportes a BOMBER_SIDE por posto */
+#define BOMBER_SIDE     4
+#define MIN_TRANSPORT   3
+
+/* distribuições de tamanho de nave */
+#define SIZE_FIXED      0   /* todas as naves com o tamanho médio */
+#define SIZE_UNIFORM    1   /* uniforme entre o mínimo e 2 * média - mínimo */
+#define SIZE_POWER      2   /* Pareto com expoente 2 e a média dada */
+
+/* permutações planejadas */
+#define PERM_RANDOM     0
+#define PERM_REVERSE    1
+#define PERM_IDENTITY   2
+
+/* tamanho do buffer de saída */
+#define OUT_BLOCK       (1 << 16)
+
+typedef struct Plan {   /* parâmetros da frota gerada */
+    int64_t npost;      /* número de postos */
+    double weight[FLEET_NTYPE];  /* peso de cada tipo no sorteio */
+    int64_t size;       /* tamanho médio das naves */
+    int32_t dist;       /* distribuição dos tamanhos */
+    int32_t perm;       /* permutação planejada */
+    bool chain;         /* fragatas em cadeia */
+    bool shuffle;       /* ids dos postos embaralhados */
+    uint64_t seed;      /* semente do gerador pseudoaleatório */
+} Plan;
+
+typedef struct Out {    /* saída de texto em blocos */
+    char buf[OUT_BLOCK];
+    size_t len;
+} Out;
+
+static uint64_t rng;    /* estado do gerador pseudoaleatório */
+
+bool parse_args(int argc, char *argv[], Plan *plan);
+bool parse_mix(const char *arg, double *weight);
+int64_t plan_ships(Plan *plan, int8_t *type, int64_t *size, int64_t *ntp);
+int32_t draw_type(Plan *plan);
+int64_t draw_size(Plan *plan, int32_t type);
+int64_t min_size(int32_t type);
+int64_t ship_ntp(int32_t type, int64_t k);
+int64_t bomber_side(int64_t k);
+void emit_ship(Out *out, int32_t type, int64_t k, const int32_t *v,
+               bool chain);
+void emit_perm(Out *out, int32_t type, int64_t k, const int32_t *v,
+               int32_t perm, int32_t *tmp);
+void emit_pair(Out *out, int64_t u, int64_t v);
+void out_flush(Out *out);
+uint64_t next_rand(void);
+int64_t rand_below(int64_t n);
+
+int main(int argc, char *argv[])
+{
+    static Out out;
+    Plan plan;
+    int8_t *type;
+    int64_t *size;
+    int32_t *lab, *tmp;
+    int64_t nship, ntp, base, kmax = 0;
+
+    if (!parse_args(argc, argv, &plan)) {
+        fprintf(stderr, USAGE);
+        return EXIT_FAILURE;
+    }
+
+    /* cada nave tem ao menos 3 postos */
+    type = malloc(plan.npost / 3 + 1);
+    size = malloc((plan.npost / 3 + 1) * sizeof(int64_t));
+    lab = malloc(plan.npost * sizeof(int32_t));
+    if (type == NULL || size == NULL || lab == NULL) {
+        fprintf(stderr, "Erro ao alocar memória\n");
+        return EXIT_FAILURE;
+    }
+    nship = plan_ships(&plan, type, size, &ntp);
+    if (ntp < FLEET_MINTP || ntp > FLEET_MAXTP) {
+        fprintf(stderr, "Erro: a frota gerada teria %" PRId64 " teleportes\n",
+                ntp);
+        return EXIT_FAILURE;
+    }
+    for (int64_t s = 0; s < nship; s++) if (size[s] > kmax) kmax = size[s];
+    if ((tmp = malloc(kmax * sizeof(int32_t))) == NULL) {
+        fprintf(stderr, "Erro ao alocar memória\n");
+        return EXIT_FAILURE;
+    }
+
+    /* lab[p] é o id, na base 1, do p-ésimo posto gerado */
+    for (int64_t p = 0; p < plan.npost; p++) lab[p] = p + 1;
+    for (int64_t p = plan.npost - 1; plan.shuffle && p > 0; p--) {
+        int64_t q = rand_below(p + 1);
+        int32_t t = lab[p]; lab[p] = lab[q]; lab[q] = t;
+    }
+
+    emit_pair(&out, plan.npost, ntp);
+    base = 0;
+    for (int64_t s = 0; s < nship; s++) {
+        emit_ship(&out, type[s], size[s], &lab[base], plan.chain);
+        base += size[s];
+    }
+    base = 0;
+    for (int64_t s = 0; s < nship; s++) {
+        emit_perm(&out, type[s], size[s], &lab[base], plan.perm, tmp);
+        base += size[s];
+    }
+    out_flush(&out);
+
+    free(type); free(size); free(lab); free(tmp);
+    return EXIT_SUCCESS;
+}
+
+bool parse_args(int argc, char *argv[], Plan *plan)
+{
+    int opt;
+
+    plan->npost = 0;
+    for (int32_t i = 0; i < FLEET_NTYPE; i++) plan->weight[i] = 1;
+    plan->size = 16;
+    plan->dist = SIZE_FIXED;
+    plan->perm = PERM_RANDOM;
+    plan->chain = false;
+    plan->shuffle = false;
+    plan->seed = 1;
+
+    while ((opt = getopt(argc, argv, "n:m:k:d:p:cex:")) != -1) {
+        switch (opt) {
+            case 'n': plan->npost = atoll(optarg); break;
+            case 'm': if (!parse_mix(optarg, plan->weight)) return false;
+                      break;
+            case 'k': plan->size = atoll(optarg); break;
+            case 'd':
+                if (strcmp(optarg, "fixo") == 0) plan->dist = SIZE_FIXED;
+                else if (strcmp(optarg, "unif") == 0) plan->dist = SIZE_UNIFORM;
+                else if (strcmp(optarg, "pot") == 0) plan->dist = SIZE_POWER;
+                else return false;
+                break;
+            case 'p':
+                if (strcmp(optarg, "aleat") == 0) plan->perm = PERM_RANDOM;
+                else if (strcmp(optarg, "inv") == 0) plan->perm = PERM_REVERSE;
+                else if (strcmp(optarg, "ident") == 0) {
+                    plan->perm = PERM_IDENTITY;
+                } else return false;
+                break;
+            case 'c': plan->chain = true; break;
+            case 'e': plan->shuffle = true; break;
+            case 'x': plan->seed = strtoull(optarg, NULL, 10); break;
+            default: return false;
+        }
+    }
+    if (optind < argc) return false;
+    if (plan->npost < FLEET_MINPOST || plan->npost > FLEET_MAXPOST) {
+        fprintf(stderr, "Erro: o número de postos deve estar entre %d e %d\n",
+                FLEET_MINPOST, FLEET_MAXPOST);
+        return false;
+    }
+    if (plan->size < MIN_FRIGATE) plan->size = MIN_FRIGATE;
+    rng = plan->seed * 0x9E3779B97F4A7C15 + 1;
+
+    return true;
+}
+
+bool parse_mix(const char *arg, double *weight)
+{   /* lê os pesos de reconhecimentos, fragatas, bombardeiros e
+       transportadores, separados por vírgulas */
+
+    double sum = 0;
+    char *end;
+
+    for (int32_t i = 0; i < FLEET_NTYPE; i++) {
+        weight[i] = strtod(arg, &end);
+        if (end == arg || weight[i] < 0) return false;
+        sum += weight[i];
+        if (i < FLEET_NTYPE - 1 && *end++ != ',') return false;
+        arg = end;
+    }
+    return *arg == '\0' && sum > 0;
+}
+
+int64_t plan_ships(Plan *plan, int8_t *type, int64_t *size, int64_t *ntp)
+{   /* sorteia o tipo e o tamanho de cada nave; como sobram sempre 0 ou ao
+       menos MIN_SHIP postos, toda nave tem o tamanho mínimo do seu tipo,
+       e a última absorve os postos que não formariam outra nave */
+
+    int64_t rem = plan->npost;
+    int64_t nship = 0;
+    int64_t k;
+
+    *ntp = 0;
+    while (rem > 0) {
+        type[nship] = draw_type(plan);
+        k = draw_size(plan, type[nship]);
+        if (k > rem || rem - k < MIN_SHIP) k = rem;
+        size[nship] = k;
+        *ntp += ship_ntp(type[nship], k);
+        rem -= k;
+        nship++;
+    }
+    return nship;
+}
+
+int32_t draw_type(Plan *plan)
+{
+    double sum = 0, x;
+    int32_t i;
+
+    for (i = 0; i < FLEET_NTYPE; i++) sum += plan->weight[i];
+    x = sum * (next_rand() >> 11) / 9007199254740992.0;
+    for (i = 0; i < FLEET_NTYPE - 1; i++) {
+        if (x < plan->weight[i]) break;
+        x -= plan->weight[i];
+    }
+    /* arredondamentos não podem sortear um tipo de peso nulo */
+    while (plan->weight[i] == 0) i--;
+    return i;
+}
+
+int64_t draw_size(Plan *plan, int32_t type)
+{
+    int64_t lo = min_size(type);
+    int64_t k = plan->size;
+    double u;
+
+    switch (plan->dist) {
+        case SIZE_UNIFORM:
+            if (k > lo) k = lo + rand_below(2 * (k - lo) + 1);
+            break;
+        case SIZE_POWER:
+            /* Pareto com expoente 2 e mínimo k / 2 tem média k */
+            u = ((next_rand() >> 11) + 1) / 9007199254740993.0;
+            k = (int64_t)fmin(k / 2.0 / sqrt(u), (double)FLEET_MAXPOST);
+            break;
+    }
+    return k < lo ? lo : k;
+}
+
+int64_t min_size(int32_t type)
+{
+    switch (type) {
+        case FLEET_SCOUT: return MIN_SCOUT;
+        case FLEET_FRIGATE: return MIN_FRIGATE;
+        case FLEET_BOMBER: return MIN_BOMBER;
+        default: return MIN_TRANSPORT;
+    }
+}
+
+int64_t ship_ntp(int32_t type, int64_t k)
+{   /* número de teleportes de uma nave de k postos */
+
+    switch (type) {
+        case FLEET_BOMBER: return bomber_side(k) * (k - bomber_side(k));
+        case FLEET_TRANSPORT: return k;
+        default: return k - 1;
+    }
+}
+
+void emit_ship(Out *out, int32_t type, int64_t k, const int32_t *v,
+               bool chain)
+{   /* emite os teleportes de uma nave de k postos, cujo i-ésimo posto na
+       ordem de geração tem o id v[i] */
+
+    int64_t a;
+
+    if (type == FLEET_FRIGATE) {
+        /* a raiz 0 tem os filhos 1, 2 e 3, e o grau 3 impede que a árvore
+           seja um caminho */
+        for (int64_t i = 1; i < 4; i++) emit_pair(out, v[0], v[i]);
+        for (int64_t i = 4; i < k; i++) {
+            if (chain) emit_pair(out, v[i - 1], v[i]);
+            else emit_pair(out, v[rand_below(i)], v[i]);
+        }
+        return;
+    }
+    if (type == FLEET_BOMBER) {
+        /* os postos 0..a-1 formam um lado, e os demais, o outro */
+        a = bomber_side(k);
+        for (int64_t i = a; i < k; i++) {
+            for (int64_t j = 0; j < a; j++) emit_pair(out, v[j], v[i]);
+        }
+        return;
+    }
+    for (int64_t i = 1; i < k; i++) emit_pair(out, v[i - 1], v[i]);
+    if (type == FLEET_TRANSPORT) emit_pair(out, v[k - 1], v[0]);
+}
+
+int64_t bomber_side(int64_t k)
+{   /* tamanho do menor lado de um bombardeiro de k postos */
+
+    return k / 2 < BOMBER_SIDE ? k / 2 : BOMBER_SIDE;
+}
+
+void emit_perm(Out *out, int32_t type, int64_t k, const int32_t *v,
+               int32_t perm, int32_t *tmp)
+{   /* emite as ocupações inicial e planejada dos k postos de uma nave; tmp
+       tem espaço para k posições */
+
+    bool cycle = type == FLEET_TRANSPORT;
+    int64_t j;
+
+    for (int64_t i = 0; i < k; i++) {
+        switch (perm) {
+            case PERM_REVERSE:
+                tmp[i] = cycle ? (i + k / 2) % k : k - 1 - i;
+                break;
+            case PERM_IDENTITY:
+                tmp[i] = i;
+                break;
+            default:
+                /* Fisher-Yates de dentro para fora */
+                j = rand_below(i + 1);
+                tmp[i] = tmp[j];
+                tmp[j] = i;
+        }
+    }
+    for (int64_t i = 0; i < k; i++) emit_pair(out, v[i], v[tmp[i]]);
+}
+
+void emit_pair(Out *out, int64_t u, int64_t v)
+{   /* grava a linha "u v", com u e v >= 0 */
+
+    char digit[20];
+    int64_t x[2] = {u, v};
+    int32_t n;
+
+    if (out->len > OUT_BLOCK - 48) out_flush(out);
+
+    for (int32_t i = 0; i < 2; i++) {
+        n = 0;
+        do { digit[n++] = '0' + x[i] % 10; x[i] /= 10; } while (x[i] > 0);
+        while (n > 0) out->buf[out->len++] = digit[--n];
+        out->buf[out->len++] = i == 0 ? ' ' : '\n';
+    }
+}
+
+void out_flush(Out *out)
+{
+    fwrite(out->buf, 1, out->len, stdout);
+    out->len = 0;
+}
+
+uint64_t next_rand(void)
+{   /* xorshift64* */
+
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545F4914F6CDD1D;
+}
+
+int64_t rand_below(int64_t n)
+{   /* valor pseudoaleatório uniforme em [0, n) */
+
+    return (int64_t)((unsigned __int128)next_rand() * n >> 64);
+}
@@ -0,0 +1,472 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Universidade Federal de Minas Gerais
+ *   Departamento de Ciência da Computação
+ *   Programa de Pós-Graduação em Ciência da Computação
+ *   Projeto e Análise de Algoritmos
+ *
+ *   Trabalho Prático - Grafos
+ *
+ *   Autor: Leandro Augusto Lacerda Campos
+ *
+ * ----------------------------------------------------------------------- */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input.h"
+
+typedef struct Block Block;
+typedef struct Chunk Chunk;
+
+struct Block {              /* bloco de linhas convertido por input_pairs() */
+    const char *start;      /* início da primeira linha do bloco */
+    const char *end;        /* fim da entrada */
+    int32_t n;              /* número de linhas do bloco */
+    InputPairFn fn;         /* destino dos pares lidos */
+    void *arg;              /* primeiro argumento de fn */
+    int32_t nchunk;         /* número de trechos */
+    int64_t *nl;            /* n. de quebras de linha em cada trecho bruto */
+    atomic_int ret;         /* 0 ou código de falha de input_pairs() */
+    const char *last;       /* posição seguinte ao último par do bloco */
+};
+
+struct Chunk {              /* trecho de um bloco, atribuído a uma thread */
+    Block *blk;
+    int32_t id;             /* de 0 a nchunk - 1 */
+};
+
+/* Declaração de funções internas */
+static int32_t read_blocks(Input *in, int fd);
+static void run_chunks(Chunk *chunk, int32_t nchunk, void *(*fn)(void *));
+static void *chunk_count(void *arg);
+static void *chunk_parse(void *arg);
+static const char *line_start(Block *blk, int64_t k);
+static bool stream_fill(Stream *st);
+static bool stream_skip(Stream *st);
+static inline bool parse_int(const char **pp, const char *end, int32_t *val);
+static inline bool is_space(char c);
+static inline int32_t digit_run(const char *p, const char *end);
+static inline uint64_t swar_value(const char *p);
+
+/* ------------------------------------------------------------------------- *
+ *
+ * Definição de funções declaradas e documentadas no arquivo input.h
+ *
+ * ------------------------------------------------------------------------- */
+
+int32_t input_open(Input *in, int fd)
+{
+    struct stat st;
+    void *buf;
+
+    if (in == NULL) return -1;
+
+    in->buf = NULL;
+    in->len = 0;
+    in->mapped = false;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (buf != MAP_FAILED) {
+            /* a entrada é lida uma única vez, do início ao fim; a leitura
+               antecipada de todo o arquivo começa já, em segundo plano, e
+               prossegue enquanto os teleportes são convertidos */
+            madvise(buf, st.st_size, MADV_SEQUENTIAL);
+            madvise(buf, st.st_size, MADV_WILLNEED);
+            in->buf = buf;
+            in->len = st.st_size;
+            in->mapped = true;
+            in->cur = in->buf;
+            return 0;
+        }
+    }
+    return read_blocks(in, fd);
+}
+
+bool input_int(Input *in, int32_t *val)
+{   /* equivalente a scanf(" %d") */
+
+    const char *p = in->cur;
+    const char *end = in->buf + in->len;
+
+    while (p < end && is_space(*p)) p++;
+
+    if (!parse_int(&p, end, val)) return false;
+
+    in->cur = p;
+    return true;
+}
+
+int32_t input_pairs(Input *in, int32_t n, InputPairFn fn, void *arg,
+                    int32_t nthread)
+{   /* as quebras de linha são contadas em paralelo em trechos brutos de
+       mesmo tamanho; depois, cada thread localiza a primeira das suas
+       n / nchunk linhas e converte os pares dessas linhas */
+
+    Block blk;
+    Chunk one, *chunk;
+    int64_t one_nl, *nl;
+    const char *p;
+    int32_t nchunk;
+
+    if (in == NULL) return -1;
+
+    if (n <= 0) return 0;
+
+    /* o bloco começa após a quebra da linha corrente, se houver */
+    p = in->cur;
+    blk.end = in->buf + in->len;
+    if (p == in->buf) {
+        blk.start = p;
+    } else {
+        while (p < blk.end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        if (p == blk.end || *p != '\n') return -1;
+        blk.start = p + 1;
+    }
+
+    nchunk = (blk.end - blk.start) / INPUT_CHUNK;
+    if (nchunk > nthread) nchunk = nthread;
+    if (nchunk > n) nchunk = n;
+    if (nchunk < 1) nchunk = 1;
+
+    chunk = malloc(nchunk * sizeof(Chunk));
+    nl = malloc(nchunk * sizeof(int64_t));
+    if (chunk == NULL || nl == NULL) {
+        /* sem memória para a conversão paralela: um único trecho */
+        free(chunk); free(nl);
+        chunk = &one;
+        nl = &one_nl;
+        nchunk = 1;
+    }
+
+    blk.n = n;
+    blk.fn = fn;
+    blk.arg = arg;
+    blk.nchunk = nchunk;
+    blk.nl = nl;
+    blk.last = NULL;
+    atomic_init(&blk.ret, 0);
+
+    for (int32_t i = 0; i < nchunk; i++) {
+        chunk[i].blk = &blk;
+        chunk[i].id = i;
+    }
+    run_chunks(chunk, nchunk, chunk_count);
+    run_chunks(chunk, nchunk, chunk_parse);
+    if (chunk != &one) { free(chunk); free(nl); }
+
+    if (atomic_load(&blk.ret) < 0) return atomic_load(&blk.ret);
+
+    in->cur = blk.last;
+    return 0;
+}
+
+void input_close(Input *in)
+{
+    if (in == NULL || in->buf == NULL) return;
+
+    if (in->mapped) munmap(in->buf, in->len);
+    else free(in->buf);
+
+    in->buf = NULL;
+    in->len = 0;
+    in->cur = NULL;
+}
+
+int32_t stream_open(Stream *st, int fd)
+{
+    if (st == NULL) return -1;
+
+    st->fd = fd;
+    st->len = 0;
+    st->cur = 0;
+    st->eof = false;
+    return 0;
+}
+
+bool stream_int(Stream *st, int32_t *val)
+{   /* o inteiro termina no primeiro espaço em branco; se ele ainda não está
+       em buf, novos bytes são lidos até que ele apareça */
+
+    const char *p, *end;
+    size_t k;
+
+    if (!stream_skip(st)) return false;
+
+    k = st->cur;
+    for (;;) {
+        while (k < st->len && !is_space(st->buf[k])) k++;
+        if (k < st->len || st->eof) break;
+        k -= st->cur;  /* stream_fill() move o conteúdo para o início */
+        if (!stream_fill(st) && !st->eof) return false;
+    }
+    p = &st->buf[st->cur];
+    end = &st->buf[k];
+    if (!parse_int(&p, end, val) || p != end) return false;
+
+    st->cur = k;
+    return true;
+}
+
+int32_t stream_pairs(Stream *st, int32_t n, InputPairFn fn, void *arg)
+{
+    int32_t i1, i2;
+
+    if (st == NULL) return -1;
+
+    for (int32_t i = 0; i < n; i++) {
+        if (!stream_int(st, &i1) || !stream_int(st, &i2)) return -1;
+        if (!fn(arg, i, i1, i2)) return -2;
+    }
+    return 0;
+}
+
+bool stream_eof(Stream *st)
+{
+    return !stream_skip(st) && st->eof && st->cur == st->len;
+}
+
+/* ------------------------------------------------------------------------- *
+ *
+ * Definições de funções internas
+ *
+ * ------------------------------------------------------------------------- */
+
+int32_t read_blocks(Input *in, int fd)
+{   /* lê todo o conteúdo de fd em um buffer que dobra de tamanho sempre que
+       não comporta mais um bloco */
+
+    size_t cap = 0;
+    ssize_t ret;
+    char *buf;
+
+    for (;;) {
+        if (cap - in->len < INPUT_BLOCK) {
+            cap = cap == 0 ? 4 * INPUT_BLOCK : 2 * cap;
+            buf = realloc(in->buf, cap);
+            if (buf == NULL) { input_close(in); return -3; }
+            in->buf = buf;
+        }
+        ret = read(fd, in->buf + in->len, cap - in->len);
+        if (ret == 0) break;
+        if (ret < 0) { input_close(in); return -2; }
+        in->len += ret;
+    }
+    in->cur = in->buf;
+    return 0;
+}
+
+void run_chunks(Chunk *chunk, int32_t nchunk, void *(*fn)(void *))
+{   /* executa fn para cada trecho em uma thread própria; o trecho 0, assim
+       como todo trecho cuja thread não pôde ser criada, é processado pela
+       thread corrente */
+
+    pthread_t *thread = malloc(nchunk * sizeof(pthread_t));
+    bool *created = calloc(nchunk, sizeof(bool));
+
+    for (int32_t i = 1; thread != NULL && created != NULL && i < nchunk; i++) {
+        created[i] = pthread_create(&thread[i], NULL, fn, &chunk[i]) == 0;
+    }
+    fn(&chunk[0]);
+    for (int32_t i = 1; i < nchunk; i++) {
+        if (created != NULL && created[i]) pthread_join(thread[i], NULL);
+        else fn(&chunk[i]);
+    }
+    free(thread); free(created);
+}
+
+void *chunk_count(void *arg)
+{   /* conta as quebras de linha do trecho bruto id */
+
+    Chunk *chunk = arg;
+    Block *blk = chunk->blk;
+    int64_t len = blk->end - blk->start;
+    const char *p = blk->start + len * chunk->id / blk->nchunk;
+    const char *end = blk->start + len * (chunk->id + 1) / blk->nchunk;
+    int64_t count = 0;
+
+    while ((p = memchr(p, '\n', end - p)) != NULL) { count++; p++; }
+    blk->nl[chunk->id] = count;
+
+    return NULL;
+}
+
+void *chunk_parse(void *arg)
+{   /* converte as linhas de id * n / nchunk a (id + 1) * n / nchunk - 1 */
+
+    Chunk *chunk = arg;
+    Block *blk = chunk->blk;
+    int64_t first = (int64_t)blk->n * chunk->id / blk->nchunk;
+    int64_t last = (int64_t)blk->n * (chunk->id + 1) / blk->nchunk;
+    const char *end = blk->end;
+    const char *p;
+    int32_t i1, i2;
+
+    if ((p = line_start(blk, first)) == NULL) goto format_error;
+
+    for (int64_t i = first; i < last; i++) {
+        /* formato da linha: [ \t]* inteiro [ \t]+ inteiro [ \t\r]* \n */
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (!parse_int(&p, end, &i1)) goto format_error;
+        if (p == end || (*p != ' ' && *p != '\t')) goto format_error;
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (!parse_int(&p, end, &i2)) goto format_error;
+
+        if (i == blk->n - 1) {
+            blk->last = p;
+        } else {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+            if (p == end || *p != '\n') goto format_error;
+            p++;
+        }
+        if (!blk->fn(blk->arg, i, i1, i2)) {
+            atomic_store(&blk->ret, -2);
+            return NULL;
+        }
+        if (atomic_load_explicit(&blk->ret, memory_order_relaxed) < 0)
+            return NULL;
+    }
+    return NULL;
+
+format_error:
+    atomic_store(&blk->ret, -1);
+    return NULL;
+}
+
+const char *line_start(Block *blk, int64_t k)
+{   /* retorna o início da linha k do bloco, isto é, a posição seguinte à
+       k-ésima quebra de linha, ou NULL se o bloco tem menos linhas */
+
+    int64_t len = blk->end - blk->start;
+    const char *p, *end;
+    int32_t i;
+
+    if (k == 0) return blk->start;
+
+    /* localiza o trecho bruto que contém a k-ésima quebra de linha */
+    for (i = 0; i < blk->nchunk && k > blk->nl[i]; i++) k -= blk->nl[i];
+    if (i == blk->nchunk) return NULL;
+
+    p = blk->start + len * i / blk->nchunk;
+    end = blk->start + len * (i + 1) / blk->nchunk;
+    while (k-- > 0) p = (const char *)memchr(p, '\n', end - p) + 1;
+
+    return p;
+}
+
+inline bool parse_int(const char **pp, const char *end, int32_t *val)
+{   /* converte o inteiro que começa em *pp, com sinal opcional, avançando *pp
+       até o fim dele; a conversão é feita em até 8 dígitos por vez quando há
+       bytes suficientes na entrada */
+
+    const char *p = *pp;
+    bool neg = false;
+    int64_t x = 0;
+    int32_t n;
+
+    if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+
+    if ((n = digit_run(p, end)) == 0) return false;
+
+    do {
+        if (n == 8) x = x * 100000000 + swar_value(p);
+        else for (int32_t i = 0; i < n; i++) x = x * 10 + (p[i] - '0');
+        p += n;
+        /* evita estouro de x, que será saturado de qualquer forma */
+        if (x > INT32_MAX) x = (int64_t)INT32_MAX + 1;
+    } while (n == 8 && (n = digit_run(p, end)) > 0);
+
+    if (neg) x = -x;
+    if (x > INT32_MAX) x = INT32_MAX;
+    if (x < INT32_MIN) x = INT32_MIN;
+
+    *val = x;
+    *pp = p;
+    return true;
+}
+
+inline bool is_space(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline int32_t digit_run(const char *p, const char *end)
+{   /* retorna a quantidade de dígitos decimais consecutivos a partir de p,
+       limitada a 8 */
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t w, t;
+
+    if (end - p >= 8) {
+        /* o byte b de w é um dígito sse sua metade alta é 3 e a metade alta
+           de b + 6 também é 3; t tem um byte não nulo para cada não-dígito */
+        memcpy(&w, p, 8);
+        t = (w & 0xF0F0F0F0F0F0F0F0)
+            | (((w + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4);
+        t ^= 0x3333333333333333;
+        return t == 0 ? 8 : __builtin_ctzll(t) / 8;
+    }
+#endif
+    int32_t n = 0;
+    while (n < 8 && p + n < end && p[n] >= '0' && p[n] <= '9') n++;
+    return n;
+}
+
+inline uint64_t swar_value(const char *p)
+{   /* converte os 8 dígitos a partir de p com três multiplicações, combinando
+       dígitos em pares, depois pares em quartetos e quartetos em octetos */
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t w;
+
+    memcpy(&w, p, 8);
+    w -= 0x3030303030303030;
+    w = (w * 10 + (w >> 8)) & 0x00FF00FF00FF00FF;
+    w = (w * 100 + (w >> 16)) & 0x0000FFFF0000FFFF;
+    w = (w * 10000 + (w >> 32)) & 0x00000000FFFFFFFF;
+    return w;
+#else
+    uint64_t x = 0;
+    for (int32_t i = 0; i < 8; i++) x = x * 10 + (p[i] - '0');
+    return x;
+#endif
+}
+
+bool stream_fill(Stream *st)
+{   /* move o conteúdo ainda não lido para o início de buf e lê de fd até
+       obter algum byte novo; retorna false no fim do fluxo, em caso de falha
+       de leitura ou se buf está cheio */
+
+    ssize_t ret;
+
+    memmove(st->buf, &st->buf[st->cur], st->len - st->cur);
+    st->len -= st->cur;
+    st->cur = 0;
+
+    while (!st->eof && st->len < STREAM_BUF) {
+        ret = read(st->fd, &st->buf[st->len], STREAM_BUF - st->len);
+        if (ret > 0) { st->len += ret; return true; }
+        if (ret == 0) st->eof = true;
+        else if (errno != EINTR) return false;
+    }
+    return false;
+}
+
+bool stream_skip(Stream *st)
+{   /* avança a posição de leitura até o próximo byte que não é espaço em
+       branco; retorna false se o fluxo terminar antes dele */
+
+    for (;;) {
+        while (st->cur < st->len && is_space(st->buf[st->cur])) st->cur++;
+        if (st->cur < st->len) return true;
+        if (!stream_fill(st)) return false;
+    }
+}
@@ -0,0 +1,129 @@
+/* ----------------------------------------------------------------------- *
+ *
+ *   Universidade Federal de Minas Gerais
+ *   Departamento de Ciência da Computação
+ *   Programa de Pós-Graduação em Ciência da Computação
+ *   Projeto e Análise de Algoritmos
+ *
+ *   Trabalho Prático - Grafos
+ *
+ *   Autor: Leandro Augusto Lacerda Campos
+ *
+ * ----------------------------------------------------------------------- */
+
+#ifndef _INPUT_H_
+#define _INPUT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* tamanho dos blocos lidos quando a entrada não pode ser mapeada */
+#define INPUT_BLOCK     (1 << 20)
+
+/* tamanho mínimo, em bytes, do trecho da entrada convertido por thread */
+#define INPUT_CHUNK     (1 << 18)
+
+/* tamanho do buffer de leitura de um fluxo */
+#define STREAM_BUF      (1 << 16)
+
+typedef struct Input Input;
+typedef struct Stream Stream;
+
+/* função que recebe o par (i1, i2) lido na linha idx de um bloco */
+typedef bool (*InputPairFn)(void *arg, int32_t idx, int32_t i1, int32_t i2);
+
+struct Input {          /* entrada de texto mantida inteira em memória */
+    char *buf;          /* conteúdo da entrada */
+    size_t len;         /* tamanho do conteúdo em bytes */
+    const char *cur;    /* posição de leitura em buf */
+    bool mapped;        /* buf foi mapeado com mmap em vez de alocado */
+};
+
+struct Stream {         /* entrada lida sob demanda, sem esperar o seu fim */
+    int fd;             /* descritor de onde o fluxo é lido */
+    size_t len;         /* quantidade de bytes válidos em buf */
+    size_t cur;         /* posição de leitura em buf */
+    bool eof;           /* read() já indicou o fim do fluxo */
+    char buf[STREAM_BUF];
+};
+
+/*
+ * input_open: disponibiliza em memória todo o conteúdo do descritor de
+ * arquivo fd para o objeto apontado por in. Se fd é um arquivo regular, o
+ * conteúdo é mapeado com mmap, sem cópia; caso contrário (ex.: um pipe), ele
+ * é lido em blocos de INPUT_BLOCK bytes. Em caso de sucesso, a função retorna
+ * 0. Em caso de falha, ela retorna:
+ *  -1: se in é NULL;
+ *  -2: se não foi possível ler de fd; ou
+ *  -3: se não foi possível alocar memória.
+ */
+int32_t input_open(Input *in, int fd);
+
+/*
+ * input_int: lê o próximo inteiro da entrada apontada por in, ignorando os
+ * espaços em branco que o antecedem, e o grava em val. A função retorna
+ * false se não há um inteiro na posição de leitura. Valores fora dos limites
+ * de int32_t são saturados em INT32_MIN ou INT32_MAX.
+ */
+bool    input_int(Input *in, int32_t *val);
+
+/*
+ * input_pairs: lê da entrada apontada por in um bloco de n linhas, cada uma
+ * com exatamente um par de inteiros, e chama fn(arg, i, i1, i2) para o par
+ * (i1, i2) da linha i do bloco, i = 0, ..., n-1. O bloco começa na linha
+ * seguinte à posição de leitura, ou no início da entrada se nada foi lido, e é
+ * dividido em até nthread trechos alinhados a linhas, que são convertidos em
+ * paralelo; por isso, fn deve aceitar chamadas concorrentes para índices
+ * distintos. Em caso de sucesso, a função avança a posição de leitura até o
+ * fim do bloco e retorna 0. Em caso de falha, a posição de leitura não é
+ * alterada e a função retorna:
+ *  -1: se in é NULL ou se o bloco não tem n linhas no formato esperado; ou
+ *  -2: se fn retornou false para algum par.
+ * Nos casos de falha, fn pode ter sido chamada para parte dos pares. Se não
+ * for possível criar alguma thread, o trecho dela é convertido pela thread
+ * corrente.
+ */
+int32_t input_pairs(Input *in, int32_t n, InputPairFn fn, void *arg,
+                    int32_t nthread);
+
+/*
+ * input_close: libera os recursos associados à entrada apontada por in.
+ */
+void    input_close(Input *in);
+
+/*
+ * stream_open: associa o fluxo apontado por st ao descritor fd, que pode ser
+ * um pipe, um terminal ou um socket. Ao contrário de input_open(), nada é lido
+ * antecipadamente: cada leitura de st consome de fd apenas os bytes
+ * necessários para completar o próximo inteiro, de modo que o fluxo pode ser
+ * usado em diálogo com quem escreve em fd. A função não aloca memória e
+ * retorna 0 em caso de sucesso ou -1 se st é NULL.
+ */
+int32_t stream_open(Stream *st, int fd);
+
+/*
+ * stream_int: equivalente a input_int() para o fluxo apontado por st. Um
+ * inteiro só é aceito quando seguido de um espaço em branco ou do fim do
+ * fluxo, e nenhum byte é lido após ele. A função também retorna false se
+ * houver falha de leitura ou se o inteiro não couber em STREAM_BUF bytes.
+ */
+bool    stream_int(Stream *st, int32_t *val);
+
+/*
+ * stream_pairs: lê do fluxo apontado por st n pares de inteiros e chama
+ * fn(arg, i, i1, i2) para o i-ésimo par (i1, i2), i = 0, ..., n-1. Os pares
+ * são separados por espaços em branco quaisquer. Em caso de sucesso, a função
+ * retorna 0. Em caso de falha, ela retorna:
+ *  -1: se st é NULL ou se não foi possível ler os n pares; ou
+ *  -2: se fn retornou false para algum par.
+ */
+int32_t stream_pairs(Stream *st, int32_t n, InputPairFn fn, void *arg);
+
+/*
+ * stream_eof: retorna true se o fluxo apontado por st terminou e todo o seu
+ * conteúdo já foi lido, exceto por espaços em branco.
+ */
+bool    stream_eof(Stream *st);
+
+#endif /* !_INPUT_H_ */
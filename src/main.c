@@ -11,57 +11,256 @@
  * 
  * ----------------------------------------------------------------------- */
 
+#define _DEFAULT_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "fleet.h"
+#include "input.h"
+
+#define USAGE   "Uso: fleet [-t threads] [-r imagem | -w imagem] " \
+                "[-s | -u socket] [--stats] < entrada\n" \
+                "     fleet [-t threads] -l lista | -d pasta\n" \
+                "     fleet [-t threads] -x memória [--stats] < entrada\n" \
+                "     fleet -c < entrada\n"
+
+typedef struct Perm {   /* ocupação inicial e planejada dos postos */
+    int32_t *p1;
+    int32_t *p2;
+} Perm;
+
+typedef struct Loader { /* leitura das ocupações em paralelo à exploração */
+    Input *in;          /* entrada posicionada antes das ocupações */
+    Perm perm;          /* ocupações lidas, com npost pares */
+    int32_t npost;      /* número de postos da frota */
+    int32_t nthread;    /* número de threads da leitura */
+    bool ok;            /* as ocupações foram lidas com sucesso; o erro só é
+                           informado por check_perm(), após as estatísticas */
+} Loader;
+
+typedef struct Query {  /* consulta do modo servidor */
+    Stream *st;         /* fluxo de onde a consulta é lida */
+    Perm perm;          /* permutação lida, com npost pares */
+    int32_t npost;      /* número de postos da frota */
+    int32_t ret;        /* 1: consulta lida; 0: fim do fluxo; -1: erro */
+    bool full;          /* a consulta foi lida e ainda não foi respondida */
+} Query;
+
+typedef struct Reader { /* thread que lê as consultas de um fluxo */
+    Query *query;       /* as duas consultas em curso, lidas alternadamente */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* alguma consulta mudou de estado */
+} Reader;
+
+typedef struct Job {    /* frota do modo em lote */
+    char *in;           /* caminho da entrada */
+    char *out;          /* caminho da saída */
+    bool ok;            /* a frota foi processada sem erros */
+} Job;
+
+typedef struct Batch {  /* frotas do modo em lote, na ordem da lista */
+    Job *job;
+    int32_t njob;
+    int32_t mjob;       /* capacidade do vetor job */
+    int32_t nthread;    /* threads da biblioteca por frota */
+    atomic_int next;    /* próxima frota a processar */
+} Batch;
 
-bool read_ints(int32_t *i1, int32_t *i2);
-bool build_fleet(Fleet *fleet);
-bool print_stat(Fleet *fleet);
-bool print_adtm(Fleet *fleet);
+typedef struct Worker { /* thread do modo em lote e os seus buffers */
+    Batch *batch;
+    Fleet fleet;        /* reaproveitada com fleet_reset() */
+    Perm perm;          /* ocupações, com capacidade para mperm postos */
+    int32_t mperm;
+} Worker;
+
+bool read_ints(Input *in, int32_t *i1, int32_t *i2, FILE *out);
+bool build_fleet(Input *in, Fleet *fleet, int32_t nthread, FILE *out);
+bool add_tp(void *arg, int32_t idx, int32_t u, int32_t v);
+bool scan_fleet(Fleet *fleet, int32_t nthread, FILE *out);
+bool load_fleet(Fleet *fleet, const char *path);
+bool save_fleet(Fleet *fleet, const char *path);
+bool print_stat(Fleet *fleet, FILE *out);
+void print_count(const int32_t *stat, FILE *out);
+bool alloc_perm(Perm *perm, int32_t npost, FILE *out);
+void *read_perm(void *arg);
+bool check_perm(Loader *ld, FILE *out);
+bool print_adtm(Fleet *fleet, Perm *perm, int32_t nthread, FILE *out);
+bool set_pair(void *arg, int32_t idx, int32_t u, int32_t v);
+int  run_server(const char *path, const char *load, const char *save,
+                int32_t nthread);
+bool stream_fleet(Stream *st, Fleet *fleet);
+bool serve(Stream *st, FILE *out, FleetWork *work, Query *query);
+int  open_socket(const char *path);
+bool serve_socket(int sock, FleetWork *work, Query *query);
+void read_query(Query *query);
+void *run_reader(void *arg);
+void wait_query(Reader *rd, Query *query, bool full);
+int  run_batch(const char *list, const char *dir, int32_t nthread);
+bool add_job(Batch *batch, const char *in, size_t nin, const char *out,
+             size_t nout);
+bool read_list(Batch *batch, const char *path);
+bool read_dir(Batch *batch, const char *path);
+int  is_input(const struct dirent *entry);
+void *run_worker(void *arg);
+bool run_job(Worker *worker, Job *job);
+int  run_xscan(int32_t mem, int32_t nthread);
+int32_t read_tp(void *arg, int32_t *p1, int32_t *p2, int32_t n);
+int  run_count(void);
+double now(void);
+void print_metrics(Fleet *fleet, double build);
+
+static const struct option long_opts[] = {
+    {"stats", no_argument, NULL, 'm'},
+    {NULL, 0, NULL, 0}
+};
+
+static bool stats = false;  /* --stats: imprime as métricas ao final */
 
 int main(int argc, char *argv[])
 {
-    Fleet fleet;
+    Input in;
+    Fleet fleet = {0};
+    Loader loader;
+    pthread_t thread;
+    bool created;
+    int32_t nthread = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *load = NULL;    /* imagem de onde a frota é carregada */
+    const char *save = NULL;    /* imagem onde a frota explorada é gravada */
+    const char *path = NULL;    /* socket de onde as consultas são lidas */
+    const char *list = NULL;    /* lista de frotas do modo em lote */
+    const char *dir = NULL;     /* pasta de frotas do modo em lote */
+    int32_t mem = 0;            /* memória, em MB, da exploração externa */
+    bool server = false;
+    bool count = false;         /* apenas a contagem de naves por tipo */
+    int32_t ret;
+    double build;
+    bool ok;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "t:r:w:su:l:d:x:c", long_opts, NULL))
+           != -1) {
+        switch (opt) {
+            case 't': nthread = atoi(optarg); break;
+            case 'r': load = optarg; break;
+            case 'w': save = optarg; break;
+            case 's': server = true; break;
+            case 'u': server = true; path = optarg; break;
+            case 'l': list = optarg; break;
+            case 'd': dir = optarg; break;
+            case 'x': mem = atoi(optarg); break;
+            case 'c': count = true; break;
+            case 'm': stats = true; break;
+            default: printf(USAGE); return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc || (load != NULL && save != NULL)
+        || (list != NULL && dir != NULL) || ((list != NULL || dir != NULL
+            || mem != 0) && (server || load != NULL || save != NULL))
+        || (mem != 0 && (mem < 1 || list != NULL || dir != NULL))
+        || (count && (server || load != NULL || save != NULL || list != NULL
+                      || dir != NULL || mem != 0 || stats))) {
+        printf(USAGE);
+        return EXIT_FAILURE;
+    }
+    if (nthread < 1) nthread = 1;
+    if (server) return run_server(path, load, save, nthread);
+    if (list != NULL || dir != NULL) return run_batch(list, dir, nthread);
+    if (mem != 0) return run_xscan(mem, nthread);
+    if (count) return run_count();
+
+    if ((ret = input_open(&in, STDIN_FILENO)) < 0) {
+        printf("Erro ao abrir a entrada: %" PRId32 "\n", ret);
+        return EXIT_FAILURE;
+    }
+
+    build = now();
+    if (load != NULL) {
+        /* a entrada contém apenas as ocupações inicial e planejada */
+        if (!load_fleet(&fleet, load)) return EXIT_FAILURE;
+    } else {
+        if (!build_fleet(&in, &fleet, nthread, stdout)) return EXIT_FAILURE;
+    }
+    build = now() - build;
+    /* as ocupações são lidas por outra thread enquanto a frota é explorada
+       e indexada */
+    loader.in = &in;
+    loader.npost = fleet.npost;
+    loader.nthread = nthread;
+    if (!alloc_perm(&loader.perm, fleet.npost, stdout)) return EXIT_FAILURE;
+    created = pthread_create(&thread, NULL, read_perm, &loader) == 0;
+
+    ok = (load != NULL || scan_fleet(&fleet, nthread, stdout))
+         && (save == NULL || save_fleet(&fleet, save));
+    /* se não houver memória para o índice de consulta em O(1), a frota
+       continua com a decomposição SQRT */
+    if (ok) fleet_index(&fleet, FLEET_LCA_RMQ);
 
-    if (!build_fleet(&fleet)) return EXIT_FAILURE;
-    if (!print_stat(&fleet)) return EXIT_FAILURE;
-    if (!print_adtm(&fleet)) return EXIT_FAILURE;
+    /* a thread de leitura é aguardada mesmo que a exploração tenha falhado;
+       um erro nas ocupações só é informado após a linha de estatísticas,
+       como na leitura sequencial */
+    if (created) pthread_join(thread, NULL);
+    else if (ok) read_perm(&loader);
+    ok = ok && print_stat(&fleet, stdout) && check_perm(&loader, stdout)
+         && print_adtm(&fleet, &loader.perm, nthread, stdout);
+    free(loader.perm.p1);
+    if (!ok) return EXIT_FAILURE;
+    print_metrics(&fleet, build);
+
+    input_close(&in);
 
     return EXIT_SUCCESS;
 }
 
-bool read_ints(int32_t *i1, int32_t *i2)
-{   /* assume que i1 e i2 apontam para objetos válidos */
+bool read_ints(Input *in, int32_t *i1, int32_t *i2, FILE *out)
+{   /* assume que in, i1 e i2 apontam para objetos válidos; os erros são
+       impressos em out, como nas demais funções de leitura e impressão */
 
-    if (scanf("%" PRId32 " %" PRId32, i1, i2) != 2) {
-        printf("Erro ao ler uma entrada de par de inteiros\n");
+    if (!input_int(in, i1) || !input_int(in, i2)) {
+        fprintf(out, "Erro ao ler uma entrada de par de inteiros\n");
         return false;
     }
     return true;
 }
 
-bool build_fleet(Fleet *fleet)
-{   /* assume que fleet aponta para um objeto válido */
+bool build_fleet(Input *in, Fleet *fleet, int32_t nthread, FILE *out)
+{   /* assume que in aponta para um objeto válido e que fleet aponta para um
+       objeto Fleet inicializado, liberado ou zerado, cujos vetores são
+       reaproveitados por fleet_reset() */
 
     int32_t npost, ntp;
     int32_t u, v;
     int32_t ret;
 
-    if (!read_ints(&npost, &ntp)) return false;
+    if (!read_ints(in, &npost, &ntp, out)) return false;
 
-    if ((ret = fleet_init(fleet, npost, ntp)) < 0) {
-        printf("Erro ao inicializar a frota: %" PRId32 "\n", ret);
+    if ((ret = fleet_reset(fleet, npost, ntp)) < 0) {
+        fprintf(out, "Erro ao inicializar a frota: %" PRId32 "\n", ret);
         return false;
     }
+    /* a leitura sequencial abaixo só é necessária se o bloco de teleportes
+       não puder ser lido em paralelo, o que inclui os casos de erro */
+    if (input_pairs(in, ntp, add_tp, fleet, nthread) == 0) return true;
+
     for (int32_t i = 0; i < ntp; i++) {
-        if (!read_ints(&u, &v)) return false;
+        if (!read_ints(in, &u, &v, out)) return false;
         u--; v--; /* corrigindo a base do índice para 0 */
         if ((ret = fleet_add(fleet, i, u, v)) < 0) {
-            printf("Erro ao adicionar o teleporte (%" PRId32
+            fprintf(out, "Erro ao adicionar o teleporte (%" PRId32
                     ", %" PRId32 "): %" PRId32 "\n", u, v, ret);
             return false;
         }
@@ -69,54 +268,704 @@ bool build_fleet(Fleet *fleet)
     return true;
 }
 
-bool print_stat(Fleet *fleet)
+bool add_tp(void *arg, int32_t idx, int32_t u, int32_t v)
+{   /* adiciona à frota apontada por arg o teleporte lido na linha idx */
+
+    return fleet_add(arg, idx, u - 1, v - 1) >= 0;
+}
+
+bool scan_fleet(Fleet *fleet, int32_t nthread, FILE *out)
 {   /* assume que fleet aponta para um objeto Fleet inicializado e que a frota 
        ainda não foi explorada */
 
-    int32_t stat[FLEET_NTYPE];
     int32_t ret;
 
-    if ((ret = fleet_scan(fleet)) < 0) {
-        printf("Erro ao explorar a frota: %" PRId32 "\n", ret);
+    if ((ret = fleet_pscan(fleet, nthread)) < 0) {
+        fprintf(out, "Erro ao explorar a frota: %" PRId32 "\n", ret);
+        return false;
+    }
+    /* se não houver memória para renumerar os postos, a frota mantém a
+       numeração da entrada */
+    fleet_relabel(fleet);
+    return true;
+}
+
+bool load_fleet(Fleet *fleet, const char *path)
+{   /* assume que fleet aponta para um objeto válido */
+
+    int32_t ret;
+
+    if ((ret = fleet_load(fleet, path)) < 0) {
+        printf("Erro ao carregar a imagem da frota: %" PRId32 "\n", ret);
+        return false;
+    }
+    return true;
+}
+
+bool save_fleet(Fleet *fleet, const char *path)
+{   /* assume que fleet aponta para um objeto Fleet já explorado */
+
+    int32_t ret;
+
+    if ((ret = fleet_save(fleet, path)) < 0) {
+        printf("Erro ao gravar a imagem da frota: %" PRId32 "\n", ret);
         return false;
     }
+    return true;
+}
+
+bool print_stat(Fleet *fleet, FILE *out)
+{   /* assume que fleet aponta para um objeto Fleet já explorado */
+
+    int32_t stat[FLEET_NTYPE];
+    int32_t ret;
+
     if ((ret = fleet_stat(fleet, stat)) < 0) {
-        printf("Erro ao obter as estatísticas da frota : %" PRId32 "\n", ret);
+        fprintf(out, "Erro ao obter as estatísticas da frota : %" PRId32 "\n",
+                ret);
         return false;
     }
 
+    print_count(stat, out);
+
+    return true;
+}
+
+void print_count(const int32_t *stat, FILE *out)
+{
     for (int32_t i = 0; i < FLEET_NTYPE; i++) {
-        printf("%d ", stat[i]);
+        fprintf(out, "%d ", stat[i]);
     }
-    putchar('\n');
+    fputc('\n', out);
+}
+
+bool alloc_perm(Perm *perm, int32_t npost, FILE *out)
+{   /* aloca em um único bloco os vetores de ocupação de npost postos */
 
+    perm->p1 = malloc(2 * (size_t)npost * sizeof(int32_t));
+    if (perm->p1 == NULL) {
+        fprintf(out, "Erro ao alocar memória\n");
+        return false;
+    }
+    perm->p2 = &perm->p1[npost];
     return true;
 }
 
-bool print_adtm(Fleet *fleet)
-{   /* assume que fleet aponta para um objeto Fleet inicializado e que a frota 
-       já tenha sido explorada */
+void *read_perm(void *arg)
+{   /* lê as ocupações para o objeto Loader apontado por arg; a entrada não é
+       acessada por outra thread durante a leitura */
+
+    Loader *ld = arg;
+    int32_t *p1 = ld->perm.p1;
+    int32_t *p2 = ld->perm.p2;
+
+    ld->ok = false;
+    if (input_pairs(ld->in, ld->npost, set_pair, &ld->perm, ld->nthread) < 0) {
+        for (int32_t i = 0; i < ld->npost; i++) {
+            if (!input_int(ld->in, &p1[i]) || !input_int(ld->in, &p2[i]))
+                return NULL;
+            p1[i]--, p2[i]--; /* corrigindo a base do índice para 0 */
+        }
+    }
+    ld->ok = true;
+    return NULL;
+}
+
+bool check_perm(Loader *ld, FILE *out)
+{   /* informa em out, com a mensagem de read_ints(), se a leitura das
+       ocupações falhou */
+
+    if (!ld->ok) fprintf(out, "Erro ao ler uma entrada de par de inteiros\n");
+    return ld->ok;
+}
+
+bool print_adtm(Fleet *fleet, Perm *perm, int32_t nthread, FILE *out)
+{   /* assume que fleet aponta para um objeto Fleet já explorado e que perm
+       contém as ocupações de todos os postos */
     
-    int32_t *p1, *p2;
     int64_t ret;
 
-    p1 = malloc(2 * fleet->npost * sizeof(int32_t));
-    if (p1 == NULL) {
+    ret = fleet_padtm(fleet, perm->p1, perm->p2, nthread);
+    if (ret < 0) {
+        fprintf(out, "Erro ao calcular o tempo de vantagem: %" PRId64 "\n",
+                ret);
+        return false;
+    }
+    fprintf(out, "%" PRId64 "\n", ret);
+
+    return true;
+}
+
+bool set_pair(void *arg, int32_t idx, int32_t u, int32_t v)
+{   /* grava o par lido na linha idx no objeto Perm apontado por arg */
+
+    Perm *perm = arg;
+
+    perm->p1[idx] = u - 1;  /* corrigindo a base do índice para 0 */
+    perm->p2[idx] = v - 1;
+    return true;
+}
+
+int run_server(const char *path, const char *load, const char *save,
+               int32_t nthread)
+{   /* explora a frota uma única vez e responde às consultas lidas da entrada
+       padrão ou, se path não é NULL, das conexões ao socket path; os
+       buffers das duas consultas em curso e os vetores de trabalho de
+       fleet_work_adtm() são alocados uma única vez, e a linha de
+       estatísticas só é impressa quando o servidor está pronto */
+
+    static Stream st;
+    Query query[2];
+    Fleet fleet;
+    FleetWork *work;
+    int32_t *buf;
+    int sock = -1;
+    double build;
+    bool ok;
+
+    build = now();
+    if (load != NULL) {
+        if (!load_fleet(&fleet, load)) return EXIT_FAILURE;
+    } else {
+        stream_open(&st, STDIN_FILENO);
+        if (!stream_fleet(&st, &fleet)) return EXIT_FAILURE;
+    }
+    build = now() - build;
+    if (load == NULL && !scan_fleet(&fleet, nthread, stdout))
+        return EXIT_FAILURE;
+    if (save != NULL && !save_fleet(&fleet, save)) return EXIT_FAILURE;
+
+    buf = malloc(4 * (size_t)fleet.npost * sizeof(int32_t));
+    work = fleet_work_new(&fleet, nthread);
+    if (buf == NULL || work == NULL) {
         printf("Erro ao alocar memória\n");
+        return EXIT_FAILURE;
+    }
+    for (int32_t i = 0; i < 2; i++) {
+        query[i].perm.p1 = &buf[2 * i * (size_t)fleet.npost];
+        query[i].perm.p2 = &buf[(2 * i + 1) * (size_t)fleet.npost];
+        query[i].npost = fleet.npost;
+    }
+    fleet_index(&fleet, FLEET_LCA_RMQ);
+    if (path != NULL && (sock = open_socket(path)) < 0) return EXIT_FAILURE;
+
+    if (!print_stat(&fleet, stdout)) return EXIT_FAILURE;
+    fflush(stdout);
+
+    if (path != NULL) {
+        ok = serve_socket(sock, work, query);
+        unlink(path);
+    } else {
+        /* sem -r, a descrição da frota já foi lida do início do fluxo */
+        if (load != NULL) stream_open(&st, STDIN_FILENO);
+        ok = serve(&st, stdout, work, query);
+    }
+    free(buf);
+    fleet_work_free(work);
+    print_metrics(&fleet, build);
+    fleet_free(&fleet);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool stream_fleet(Stream *st, Fleet *fleet)
+{   /* equivalente a build_fleet(), mas lendo apenas a descrição da frota do
+       fluxo apontado por st */
+
+    int32_t npost, ntp;
+    int32_t ret;
+
+    if (!stream_int(st, &npost) || !stream_int(st, &ntp)) {
+        printf("Erro ao ler uma entrada de par de inteiros\n");
         return false;
     }
-    p2 = &p1[fleet->npost];
-    for (int32_t i = 0; i < fleet->npost; i++) {
-        if (!read_ints(&p1[i], &p2[i])) return false;
-        p1[i]--, p2[i]--; /* corrigindo a base do índice para 0 */
+    if ((ret = fleet_init(fleet, npost, ntp)) < 0) {
+        printf("Erro ao inicializar a frota: %" PRId32 "\n", ret);
+        return false;
     }
-    ret = fleet_adtm(fleet, p1, p2);
-    free(p1);
-    if (ret < 0) {
-        printf("Erro ao calcular o tempo de vantagem: %" PRId64 "\n", ret);
+    if ((ret = stream_pairs(st, ntp, add_tp, fleet)) < 0) {
+        printf("Erro ao ler os teleportes: %" PRId32 "\n", ret);
         return false;
     }
-    printf("%" PRId64 "\n", ret);
+    return true;
+}
+
+bool serve(Stream *st, FILE *out, FleetWork *work, Query *query)
+{   /* cada consulta é uma linha com o número de pares, que deve ser igual ao
+       número de postos, seguida dos pares; uma única thread lê as consultas
+       do fluxo, alternando entre os dois buffers, enquanto a corrente é
+       respondida. Retorna false se o fluxo não termina ao fim de uma
+       consulta */
+
+    Reader rd = {.query = query};
+    pthread_t thread;
+    int32_t cur = 0;
+    bool created;
+    int64_t ret;
+
+    for (int32_t i = 0; i < 2; i++) {
+        query[i].st = st;
+        query[i].full = false;
+    }
+    pthread_mutex_init(&rd.lock, NULL);
+    pthread_cond_init(&rd.cond, NULL);
+    created = pthread_create(&thread, NULL, run_reader, &rd) == 0;
+
+    for (;;) {
+        /* sem a thread de leitura, cada consulta é lida antes de respondida */
+        if (created) wait_query(&rd, &query[cur], true);
+        else read_query(&query[cur]);
+        if (query[cur].ret <= 0) break;
+
+        ret = fleet_work_adtm(work, query[cur].perm.p1, query[cur].perm.p2);
+        if (ret < 0) {
+            fprintf(out, "Erro ao calcular o tempo de vantagem: %" PRId64
+                    "\n", ret);
+        } else {
+            fprintf(out, "%" PRId64 "\n", ret);
+        }
+        fflush(out);
+
+        if (created) {
+            pthread_mutex_lock(&rd.lock);
+            query[cur].full = false;
+            pthread_cond_signal(&rd.cond);
+            pthread_mutex_unlock(&rd.lock);
+        }
+        cur ^= 1;
+    }
+    /* a thread de leitura termina após a consulta que encerrou o laço */
+    if (created) pthread_join(thread, NULL);
+    pthread_mutex_destroy(&rd.lock);
+    pthread_cond_destroy(&rd.cond);
+
+    if (query[cur].ret < 0) {
+        fprintf(out, "Erro ao ler a consulta\n");
+        fflush(out);
+        return false;
+    }
+    return true;
+}
+
+int open_socket(const char *path)
+{   /* cria um socket Unix em path, substituindo um arquivo já existente, e
+       retorna o seu descritor, ou -1 em caso de falha */
+
+    struct sockaddr_un addr;
+    int sock;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("Erro ao criar o socket: caminho muito longo\n");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        printf("Erro ao criar o socket: %d\n", errno);
+        return -1;
+    }
+    unlink(path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(sock, SOMAXCONN) < 0) {
+        printf("Erro ao criar o socket: %d\n", errno);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+bool serve_socket(int sock, FleetWork *work, Query *query)
+{   /* atende uma conexão por vez, até que accept() falhe; um erro em uma
+       consulta encerra apenas a conexão corrente */
+
+    static Stream st;
+    FILE *out;
+    int conn;
+
+    /* um cliente que fecha a conexão antes da resposta não encerra o
+       servidor */
+    signal(SIGPIPE, SIG_IGN);
+
+    for (;;) {
+        if ((conn = accept(sock, NULL, NULL)) < 0) {
+            if (errno == EINTR) continue;
+            printf("Erro ao aceitar uma conexão: %d\n", errno);
+            break;
+        }
+        if ((out = fdopen(conn, "w")) == NULL) {
+            close(conn);
+            continue;
+        }
+        stream_open(&st, conn);
+        serve(&st, out, work, query);
+        fclose(out);
+    }
+    close(sock);
+    return false;
+}
+
+void read_query(Query *query)
+{   /* lê a próxima consulta do fluxo para o objeto Query apontado por query */
+
+    int32_t n;
+
+    if (!stream_int(query->st, &n)) {
+        query->ret = stream_eof(query->st) ? 0 : -1;
+        return;
+    }
+    if (n != query->npost
+        || stream_pairs(query->st, n, set_pair, &query->perm) < 0) {
+        query->ret = -1;
+        return;
+    }
+    query->ret = 1;
+}
+
+void *run_reader(void *arg)
+{   /* lê as consultas do fluxo alternadamente para os dois buffers do
+       objeto Reader apontado por arg, esperando que cada buffer seja
+       liberado pela resposta anterior, até o fim do fluxo ou um erro */
+
+    Reader *rd = arg;
+    Query *query;
+
+    for (int32_t cur = 0; ; cur ^= 1) {
+        query = &rd->query[cur];
+        wait_query(rd, query, false);
+        read_query(query);
+
+        pthread_mutex_lock(&rd->lock);
+        query->full = true;
+        pthread_cond_signal(&rd->cond);
+        pthread_mutex_unlock(&rd->lock);
+        if (query->ret <= 0) return NULL;
+    }
+}
+
+void wait_query(Reader *rd, Query *query, bool full)
+{   /* espera até que a consulta apontada por query esteja lida, se full é
+       verdadeiro, ou respondida, caso contrário */
+
+    pthread_mutex_lock(&rd->lock);
+    while (query->full != full) pthread_cond_wait(&rd->cond, &rd->lock);
+    pthread_mutex_unlock(&rd->lock);
+}
+
+int run_batch(const char *list, const char *dir, int32_t nthread)
+{   /* processa as frotas da lista ou da pasta em um conjunto fixo de
+       threads, cada uma com a sua frota e as suas ocupações reaproveitadas
+       de uma frota para a seguinte; as threads que sobram para além do
+       número de frotas são repartidas entre as frotas, e as falhas são
+       informadas ao final, na ordem da lista */
+
+    Batch batch = {0};
+    Worker *worker;
+    pthread_t *thread;
+    int32_t nworker;
+    bool ok = true;
+
+    if (list != NULL ? !read_list(&batch, list) : !read_dir(&batch, dir)) {
+        printf("Erro ao ler a lista de frotas de %s\n",
+               list != NULL ? list : dir);
+        return EXIT_FAILURE;
+    }
+    if (batch.njob == 0) return EXIT_SUCCESS;
+
+    nworker = batch.njob < nthread ? batch.njob : nthread;
+    batch.nthread = nthread / nworker;
+    atomic_init(&batch.next, 0);
+
+    worker = calloc((size_t)nworker, sizeof(Worker));
+    thread = malloc((size_t)nworker * sizeof(pthread_t));
+    if (worker == NULL || thread == NULL) {
+        printf("Erro ao alocar memória\n");
+        return EXIT_FAILURE;
+    }
+    for (int32_t i = 0; i < nworker; i++) {
+        worker[i].batch = &batch;
+        /* se não for possível criar a thread, as frotas dela são
+           processadas pelas demais ou, na falta delas, pela corrente */
+        if (i > 0 && pthread_create(&thread[i], NULL, run_worker, &worker[i])
+            != 0) worker[i].batch = NULL;
+    }
+    run_worker(&worker[0]);
+    for (int32_t i = 1; i < nworker; i++) {
+        if (worker[i].batch != NULL) pthread_join(thread[i], NULL);
+    }
+
+    for (int32_t i = 0; i < batch.njob; i++) {
+        if (!batch.job[i].ok) {
+            printf("Erro ao processar a frota %s; veja %s\n",
+                   batch.job[i].in, batch.job[i].out);
+            ok = false;
+        }
+        free(batch.job[i].in); free(batch.job[i].out);
+    }
+    free(batch.job); free(worker); free(thread);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool add_job(Batch *batch, const char *in, size_t nin, const char *out,
+             size_t nout)
+{   /* acrescenta ao lote a frota de entrada in[0..nin-1] e saída
+       out[0..nout-1] */
 
+    Job *job;
+
+    if (batch->njob == batch->mjob) {
+        job = realloc(batch->job,
+                      (batch->mjob > 0 ? 2 * batch->mjob : 64) * sizeof(Job));
+        if (job == NULL) return false;
+        batch->job = job;
+        batch->mjob = batch->mjob > 0 ? 2 * batch->mjob : 64;
+    }
+    job = &batch->job[batch->njob];
+    job->in = strndup(in, nin);
+    job->out = strndup(out, nout);
+    job->ok = false;
+    if (job->in == NULL || job->out == NULL) {
+        free(job->in); free(job->out);
+        return false;
+    }
+    batch->njob++;
     return true;
-}
\ No newline at end of file
+}
+
+bool read_list(Batch *batch, const char *path)
+{   /* lê uma frota por linha, no formato "entrada saída"; linhas em branco
+       são ignoradas */
+
+    FILE *file;
+    char *line = NULL, *in, *out;
+    size_t cap = 0, nin, nout;
+    bool ok = true;
+
+    if ((file = fopen(path, "r")) == NULL) return false;
+
+    while (ok && getline(&line, &cap, file) != -1) {
+        in = line + strspn(line, " \t\r\n");
+        if (*in == '\0') continue;
+        nin = strcspn(in, " \t\r\n");
+        out = in + nin + strspn(in + nin, " \t\r\n");
+        nout = strcspn(out, " \t\r\n");
+        /* exatamente dois caminhos por linha */
+        ok = nout > 0 && out[nout + strspn(out + nout, " \t\r\n")] == '\0'
+             && add_job(batch, in, nin, out, nout);
+    }
+    ok = ok && !ferror(file);
+    free(line);
+    fclose(file);
+
+    return ok;
+}
+
+bool read_dir(Batch *batch, const char *path)
+{   /* cada arquivo nome.in da pasta, em ordem alfabética, tem a saída
+       gravada em nome.out, na mesma pasta */
+
+    struct dirent **entry;
+    char *name, *in, *out;
+    size_t len;
+    int n;
+    bool ok = true;
+
+    if ((n = scandir(path, &entry, is_input, alphasort)) < 0) return false;
+
+    for (int i = 0; i < n; i++) {
+        name = entry[i]->d_name;
+        len = strlen(path) + strlen(name) + 2;
+        if (ok && (in = malloc(2 * len + 1)) != NULL) {
+            out = in + len;
+            snprintf(in, len, "%s/%s", path, name);
+            snprintf(out, len + 1, "%s/%.*s.out", path,
+                     (int)strlen(name) - 3, name);
+            ok = add_job(batch, in, strlen(in), out, strlen(out));
+            free(in);
+        } else {
+            ok = false;
+        }
+        free(entry[i]);
+    }
+    free(entry);
+
+    return ok;
+}
+
+int is_input(const struct dirent *entry)
+{   /* seleciona para scandir() os arquivos terminados em ".in" */
+
+    size_t len = strlen(entry->d_name);
+
+    return len > 3 && strcmp(entry->d_name + len - 3, ".in") == 0;
+}
+
+void *run_worker(void *arg)
+{   /* processa frotas do lote até que não haja mais frotas */
+
+    Worker *worker = arg;
+    Batch *batch = worker->batch;
+    int32_t i;
+
+    while ((i = atomic_fetch_add(&batch->next, 1)) < batch->njob) {
+        batch->job[i].ok = run_job(worker, &batch->job[i]);
+    }
+    fleet_free(&worker->fleet);
+    free(worker->perm.p1);
+    return NULL;
+}
+
+bool run_job(Worker *worker, Job *job)
+{   /* equivalente a uma execução do programa com a entrada job->in e a
+       saída job->out, mas reaproveitando a frota e as ocupações da thread */
+
+    Fleet *fleet = &worker->fleet;
+    Loader loader;
+    Input in;
+    FILE *out;
+    int32_t ret;
+    int fd;
+    bool ok;
+
+    if ((out = fopen(job->out, "w")) == NULL) return false;
+
+    /* um arquivo que não pode ser aberto equivale a um que não pode ser
+       lido */
+    fd = open(job->in, O_RDONLY);
+    ret = fd < 0 ? -2 : input_open(&in, fd);
+    if (fd >= 0) close(fd);
+    if (ret < 0) {
+        fprintf(out, "Erro ao abrir a entrada: %" PRId32 "\n", ret);
+        fclose(out);
+        return false;
+    }
+
+    ok = build_fleet(&in, fleet, worker->batch->nthread, out)
+         && scan_fleet(fleet, worker->batch->nthread, out);
+    if (ok) {
+        fleet_index(fleet, FLEET_LCA_RMQ);
+        if (fleet->npost > worker->mperm) {
+            free(worker->perm.p1);
+            worker->mperm = 0;
+            ok = alloc_perm(&worker->perm, fleet->npost, out);
+            if (ok) worker->mperm = fleet->npost;
+        }
+    }
+    if (ok) {
+        loader.in = &in;
+        loader.perm = worker->perm;
+        loader.npost = fleet->npost;
+        loader.nthread = worker->batch->nthread;
+        read_perm(&loader);
+        ok = print_stat(fleet, out) && check_perm(&loader, out)
+             && print_adtm(fleet, &worker->perm, worker->batch->nthread, out);
+    }
+    input_close(&in);
+
+    return fclose(out) == 0 && ok;
+}
+
+int run_xscan(int32_t mem, int32_t nthread)
+{   /* explora a frota com fleet_xscan(), lendo a entrada padrão como um
+       fluxo, de modo que nem a entrada nem os teleportes fiquem inteiros em
+       memória; a saída é idêntica à do modo padrão */
+
+    static Stream st;
+    Fleet fleet;
+    Perm perm;
+    int32_t npost, ntp, ret;
+    double build;
+    bool ok;
+
+    stream_open(&st, STDIN_FILENO);
+    if (!stream_int(&st, &npost) || !stream_int(&st, &ntp)) {
+        printf("Erro ao ler uma entrada de par de inteiros\n");
+        return EXIT_FAILURE;
+    }
+    build = now();
+    ret = fleet_xscan(&fleet, npost, ntp, read_tp, &st, (size_t)mem << 20);
+    build = now() - build;
+    if (ret == -2) {
+        printf("Erro ao inicializar a frota: %" PRId32 "\n", ret);
+        return EXIT_FAILURE;
+    } else if (ret < 0) {
+        printf("Erro ao explorar a frota: %" PRId32 "\n", ret);
+        return EXIT_FAILURE;
+    }
+
+    if (!alloc_perm(&perm, npost, stdout)) return EXIT_FAILURE;
+    ok = stream_pairs(&st, npost, set_pair, &perm) == 0;
+    /* como no modo padrão, um erro nas ocupações só é informado após a linha
+       de estatísticas */
+    if (!print_stat(&fleet, stdout)) {
+        ok = false;
+    } else if (!ok) {
+        printf("Erro ao ler uma entrada de par de inteiros\n");
+    } else {
+        ok = print_adtm(&fleet, &perm, nthread, stdout);
+    }
+    free(perm.p1);
+    if (ok) print_metrics(&fleet, build);
+    fleet_free(&fleet);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int32_t read_tp(void *arg, int32_t *p1, int32_t *p2, int32_t n)
+{   /* lê do fluxo apontado por arg até n teleportes, convertidos para a
+       base 0 */
+
+    for (int32_t i = 0; i < n; i++) {
+        if (!stream_int(arg, &p1[i]) || !stream_int(arg, &p2[i])) return i;
+        p1[i]--; p2[i]--;
+    }
+    return n;
+}
+
+int run_count(void)
+{   /* imprime apenas a contagem de naves por tipo, obtida por fleet_count()
+       enquanto os teleportes são lidos como um fluxo; as ocupações não são
+       lidas, e a frota não é montada nem explorada */
+
+    static Stream st;
+    int32_t stat[FLEET_NTYPE];
+    int32_t npost, ntp, ret;
+
+    stream_open(&st, STDIN_FILENO);
+    if (!stream_int(&st, &npost) || !stream_int(&st, &ntp)) {
+        printf("Erro ao ler uma entrada de par de inteiros\n");
+        return EXIT_FAILURE;
+    }
+    ret = fleet_count(npost, ntp, read_tp, &st, stat);
+    if (ret == -2) {
+        printf("Erro ao inicializar a frota: %" PRId32 "\n", ret);
+        return EXIT_FAILURE;
+    } else if (ret < 0) {
+        printf("Erro ao contar as naves da frota: %" PRId32 "\n", ret);
+        return EXIT_FAILURE;
+    }
+    print_count(stat, stdout);
+
+    return EXIT_SUCCESS;
+}
+
+double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void print_metrics(Fleet *fleet, double build)
+{   /* com --stats, imprime na saída de erro, em uma linha no formato JSON, o
+       tempo de leitura e montagem da frota (ou de carga da imagem) e as
+       métricas acumuladas pela biblioteca */
+
+    if (!stats) return;
+    fprintf(stderr, "{\"montagem\": %.6f, \"frota\": ", build);
+    fleet_metrics(fleet, stderr);
+    fprintf(stderr, "}\n");
+}
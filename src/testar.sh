@@ -0,0 +1,159 @@
+#!/bin/bash
+# Compila o programa, confere a saída de cada test/in/*.in com test/out e mede
+# as fases de cada entrada e de duas frotas sintéticas com o bench. O menor
+# tempo de cada fase em N execuções é gravado em formato JSON. O teste falha
+# se as contagens de naves ou o tempo de vantagem diferirem da linha de base
+# versionada, ou se uma fase ficar mais lenta que LIMITE * base + FOLGA
+# segundos, com os tempos da base gravados nesta máquina na primeira execução.
+#
+# uso: ./testar.sh [-b] [-l limite] [-f folga] [-n vezes] [-o resultado]
+#   -b  grava o resultado como nova linha de base, sem comparar
+#   -l  razão máxima entre o tempo medido e o da base (padrão: 1.5)
+#   -f  folga absoluta em segundos, para fases muito curtas (padrão: 0.005)
+#   -n  número de execuções do bench por entrada (padrão: 3)
+#   -o  arquivo JSON do resultado (padrão: ../test/resultado.json)
+
+cd "$(dirname "$0")" || exit 1
+
+base=../test/base.json      # contagens e tempo de vantagem, versionados
+tempos=../test/tempos.json  # tempos das fases, próprios de cada máquina
+limite=1.5
+folga=0.005
+vezes=3
+saida=../test/resultado.json
+gravar=0
+
+while getopts "bl:f:n:o:" opt; do
+    case $opt in
+        b) gravar=1 ;;
+        l) limite=$OPTARG ;;
+        f) folga=$OPTARG ;;
+        n) vezes=$OPTARG ;;
+        o) saida=$OPTARG ;;
+        *) sed -n 's/^# \?//; 9,14p' "$0"; exit 1 ;;
+    esac
+done
+
+./compilar.sh || exit 1
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+falha=0
+
+# correção: saída com uma e com várias threads
+for f in ../test/in/*.in; do
+    nome=$(basename "$f" .in)
+    for t in 1 "$(nproc)"; do
+        if ! ./fleet -t "$t" < "$f" | diff -Z -q - "../test/out/$nome.out" \
+                > /dev/null; then
+            echo "FALHA: $nome com $t thread(s) difere de test/out/$nome.out"
+            falha=1
+        fi
+    done
+done
+
+# frotas sintéticas, geradas com semente fixa
+./gerador -n 1000000 -k 64 -d pot -e -x 1 > "$tmp/mista_1m.in"
+./gerador -n 1000000 -c -m 0,1,0,0 -k 100000 -p inv -x 1 \
+    > "$tmp/cadeia_1m.in"
+
+# desempenho: o menor tempo de cada fase em $vezes execuções
+{
+    echo "{\"limite\": $limite, \"folga\": $folga, \"entradas\": ["
+    primeiro=1
+    for f in ../test/in/*.in "$tmp"/*.in; do
+        nome=$(basename "$f" .in)
+        for i in $(seq "$vezes"); do
+            ./bench -j < "$f" || echo "ERRO"
+        done | awk -v nome="$nome" -v primeiro="$primeiro" '
+            /ERRO/ { erro = 1; next }
+            {
+                linha = $0
+                if (!match(linha, /"fases": \{[^}]*\}/)) { erro = 1; next }
+                n = split(substr(linha, RSTART + 10, RLENGTH - 11), par, ", ")
+                for (i = 1; i <= n; i++) {
+                    split(par[i], kv, ": ")
+                    if (!(kv[1] in menor) || kv[2] + 0 < menor[kv[1]]) {
+                        menor[kv[1]] = kv[2] + 0
+                    }
+                    if (NR == 1) ordem[i] = kv[1]
+                }
+                if (NR == 1) { nfase = n; resto = substr(linha, 2, RSTART - 2) }
+            }
+            END {
+                if (erro || NR == 0) { print "ERRO " nome > "/dev/stderr"; exit 1 }
+                printf("%s{\"nome\": \"%s\", %s\"fases\": {",
+                       (primeiro ? "" : ",\n"), nome, resto)
+                for (i = 1; i <= nfase; i++) {
+                    printf("%s%s: %.6f", (i > 1 ? ", " : ""), ordem[i],
+                           menor[ordem[i]])
+                }
+                printf "}}"
+            }' || falha=1
+        primeiro=0
+    done
+    echo
+    echo "]}"
+} > "$saida"
+
+if [ "$gravar" = 1 ]; then
+    # a base versionada não guarda o que depende da máquina
+    sed -E 's/^\{"limite": [^,]*, "folga": [^,]*, /{/
+            s/, "rss_kb": [0-9]+//; s/, "fases": \{[^}]*\}//' \
+        "$saida" > "$base"
+    cp "$saida" "$tempos"
+    echo "Linha de base gravada em $base e $tempos"
+else
+    if [ ! -f "$base" ]; then
+        echo "Sem linha de base em $base; use -b para gravá-la"
+    fi
+    if [ ! -f "$tempos" ]; then
+        cp "$saida" "$tempos"
+        echo "Tempos desta máquina gravados em $tempos"
+    fi
+    # compara as contagens de cada entrada com a base versionada e cada fase
+    # com os tempos desta máquina; uma base ausente é substituída por
+    # /dev/null
+    [ -f "$base" ] || base=/dev/null
+    awk -v limite="$limite" -v folga="$folga" '
+        function campos(linha, v,    nome, n, par, kv, i) {
+            match(linha, /"nome": "[^"]*"/)
+            nome = substr(linha, RSTART + 9, RLENGTH - 10)
+            match(linha, /"naves": \[[^]]*\], "vantagem": -?[0-9]+/)
+            v[nome, "contagens"] = substr(linha, RSTART, RLENGTH)
+            match(linha, /"fases": \{[^}]*\}/)
+            n = split(substr(linha, RSTART + 10, RLENGTH - 11), par, ", ")
+            for (i = 1; i <= n; i++) {
+                split(par[i], kv, ": ")
+                gsub(/"/, "", kv[1])
+                v[nome, kv[1]] = kv[2] + 0
+                fase[nome, i] = kv[1]
+            }
+            return nome
+        }
+        FILENAME == ARGV[1] && /"nome"/ { campos($0, base); next }
+        FILENAME == ARGV[2] && /"nome"/ { campos($0, tempo); next }
+        /"nome"/ {
+            nome = campos($0, atual)
+            if (((nome, "contagens") in base) &&
+                atual[nome, "contagens"] != base[nome, "contagens"]) {
+                printf("FALHA: %s: %s, na base %s\n", nome,
+                       atual[nome, "contagens"], base[nome, "contagens"])
+                falha = 1
+            }
+            for (i = 1; (nome, i) in fase; i++) {
+                f = fase[nome, i]
+                if (!((nome, f) in tempo)) continue
+                t = atual[nome, f]; b = tempo[nome, f]
+                if (t > limite * b + folga) {
+                    printf("FALHA: %s: fase %s levou %.6f s, na base %.6f s\n",
+                           nome, f, t, b)
+                    falha = 1
+                }
+            }
+        }
+        END { exit falha }' "$base" "$tempos" "$saida" || falha=1
+fi
+
+if [ "$falha" = 0 ]; then echo "OK"; else echo "FALHOU"; fi
+exit "$falha"